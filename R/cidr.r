@@ -1,6 +1,13 @@
-#' Convert a \emph{pyasn} generated CIDR data file to a trie
+#' Convert a \emph{pyasn} generated CIDR data file to a prefix table
+#'
+#' The prefixes are compiled into a native longest-prefix-match table (a
+#' three-level multibit trie) held behind an external pointer, so lookups
+#' with \code{ip_to_asn()} work directly on numeric addresses. The table
+#' cannot be saved with \code{saveRDS()}; use \code{\link{write_prefix_table}()}
+#' to save it in a form that loads almost instantly.
 #'
 #' @param asn_table_file filename of dat file (can be gzip'd)
+#' @return an object of class \code{iptools_prefix_table}
 #' @export
 #' @examples
 #' asn_table_to_trie(system.file("test", "rib.tst", package="iptools"))
@@ -22,23 +29,29 @@ asn_table_to_trie <- function(asn_table_file) {
   cidr_split <- stri_split_fixed(rip$cidr, "/", 2, simplify = TRUE)
 
   ip <- cidr_split[,1]
-  mask <- cidr_split[,2]
-  prefix <- stri_sub(ip_to_binary_string(ip), 1, mask)
+  mask <- suppressWarnings(as.integer(cidr_split[,2]))
 
-  triebeard::trie(prefix, rip$asn)
+  prefix_table_build(ip, mask, rip$asn)
 
 }
 
 #' Match IP addresses to autonomous systems
 #'
-#' @param cidr_trie trie created with \code{asn_table_to_trie()}
+#' @param cidr_trie prefix table created with \code{asn_table_to_trie()} (a
+#'        \pkg{triebeard} trie built by older versions of \code{iptools} also works)
 #' @param ip character vector or numeric vector of IPv4 addresses
+#' @return character vector of the matching autonomous systems, \code{NA} where
+#'         no prefix covers the address (or it isn't a valid IPv4 address)
 #' @export
 #' @examples
 #' tbl <- asn_table_to_trie(system.file("test", "rib.tst", package="iptools"))
 #' ip_to_asn(tbl, "5.192.0.1")
 ip_to_asn <- function(cidr_trie, ip) {
 
+  if (inherits(cidr_trie, "iptools_prefix_table")) {
+    return(prefix_table_lookup(cidr_trie, ip))
+  }
+
   if (inherits(ip, "numeric")) {
     ip <- ip_numeric_to_binary_string(ip)
   } else {
@@ -49,6 +62,51 @@ ip_to_asn <- function(cidr_trie, ip) {
 
 }
 
+#' Save and load compiled prefix tables
+#'
+#' \code{write_prefix_table()} saves a prefix table built by
+#' \code{\link{asn_table_to_trie}()} in a versioned binary format, and
+#' \code{read_prefix_table()} loads one. Loading memory-maps the file read-only
+#' and queries it in place rather than rebuilding the table, so it is close to
+#' instant, and R processes on the same host that load the same file share one
+#' copy of it in memory.
+#'
+#' The file is checked when it is loaded, and must not be changed while any
+#' process has it loaded. It is written in the byte order of the machine that
+#' wrote it, and can only be read on machines with the same byte order.
+#'
+#' @param x a prefix table
+#' @param file path of the file to write or read
+#' @return \code{write_prefix_table()} returns \code{x}, invisibly;
+#'         \code{read_prefix_table()} returns an object of class \code{iptools_prefix_table}
+#' @export
+#' @examples
+#' tbl <- asn_table_to_trie(system.file("test", "rib.tst", package="iptools"))
+#' tbl_file <- tempfile(fileext = ".iptbl")
+#' write_prefix_table(tbl, tbl_file)
+#' ip_to_asn(read_prefix_table(tbl_file), "5.192.0.1")
+write_prefix_table <- function(x, file) {
+  prefix_table_write(x, path.expand(file))
+  invisible(x)
+}
+
+#' @rdname write_prefix_table
+#' @export
+read_prefix_table <- function(file) {
+  prefix_table_read(path.expand(file))
+}
+
+#' @export
+dim.iptools_prefix_table <- function(x) {
+  prefix_table_size(x)
+}
+
+#' @export
+print.iptools_prefix_table <- function(x, ...) {
+  cat(sprintf("<iptools prefix table: %s prefixes>\n", format(dim(x), big.mark = ",")))
+  invisible(x)
+}
+
 #' Determine if a vector if IPv4 addresses are in a vector of CIDRs
 #'
 #' @param ips character vector or numeric vector of IPv4 addresses
@@ -0,0 +1,259 @@
+// Throughput of the header-only cores behind the exported functions (the
+// parsers and formatters, the CIDR interval index behind ip_in_any, the
+// interval table behind ip_to_country, the X-Forwarded-For scanner, the
+// CIDR decomposer and the radix sort behind ip_order), without R in the
+// way. The prefixes come from inst/test/rib.tst, the addresses from a fixed
+// seed, and every benchmark runs on clean input and on input where 30% of
+// the values are junk.
+//
+//   make core && ./core [n] [path to rib.tst] > core.csv
+//
+// Output is CSV, in the same columns as run.R writes.
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cidr.h"
+#include "interval_table.h"
+#include "ip_parse.h"
+#include "ip_sort.h"
+
+static const unsigned int seed = 1492;
+
+static const char *junk[] = { "-", "unknown", "", "10.0.0.256", "10.0.0", " 10.0.0.1", "::g", "fe80::1::2" };
+static const size_t junk_count = sizeof(junk) / sizeof(junk[0]);
+
+struct workload {
+  const char *name;
+  double dirty;
+};
+
+static const workload workloads[] = { { "clean", 0.0 }, { "dirty-30", 0.3 } };
+
+/**
+ * @return the process's peak resident set size so far, in kilobytes.
+ */
+static long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+static void report(const char *benchmark, const char *workload, size_t n, double secs, uint64_t checksum) {
+  printf("core,%s,%s,%lu,%.6f,%.0f,%ld\n", benchmark, workload, (unsigned long) n, secs,
+         secs > 0 ? n / secs : 0.0, peak_rss_kb());
+  // keeps the work from being optimised away
+  fprintf(stderr, "%s/%s checksum %llu\n", benchmark, workload, (unsigned long long) checksum);
+}
+
+template < typename F >
+static void run(const char *benchmark, const char *workload, size_t n, F body) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint64_t checksum = body();
+  double secs = std::chrono::duration < double >(std::chrono::steady_clock::now() - start).count();
+  report(benchmark, workload, n, secs, checksum);
+}
+
+static std::string v4_string(uint32_t ip) {
+  char buf[16];
+  return std::string(buf, format_ipv4(ip, buf));
+}
+
+static std::string v6_string(std::mt19937& rng) {
+  uint8_t bytes[16];
+  char buf[46];
+  // mostly global unicast, with runs of zeros so compression has work to do
+  for (int i = 0; i < 16; i++) {
+    bytes[i] = (i >= 6 && i < 12 && rng() % 2) ? 0 : (uint8_t) rng();
+  }
+  bytes[0] = 0x20 | (bytes[0] & 0x0f);
+  return std::string(buf, format_ipv6_compressed(bytes, buf));
+}
+
+static std::vector < std::string > make_addresses(size_t n, double dirty, bool v6, std::mt19937& rng) {
+  std::uniform_real_distribution < double > coin(0, 1);
+  std::vector < std::string > out(n);
+  for (size_t i = 0; i < n; i++) {
+    if (coin(rng) < dirty) {
+      out[i] = junk[rng() % junk_count];
+    } else {
+      out[i] = v6 ? v6_string(rng) : v4_string((uint32_t) rng());
+    }
+  }
+  return out;
+}
+
+struct rib_prefix {
+  uint32_t network;
+  int length;
+  int asn;
+};
+
+static std::vector < rib_prefix > read_rib(const char *path) {
+  std::vector < rib_prefix > out;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == ';') {
+      continue;
+    }
+    size_t tab = line.find('\t');
+    uint128 address;
+    int length;
+    if (tab == std::string::npos || cidr_parse(line.data(), tab, &address, &length) != 4) {
+      continue;
+    }
+    rib_prefix p = { (uint32_t) address.lo, length, atoi(line.c_str() + tab + 1) };
+    out.push_back(p);
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  const char *rib_path = argc > 2 ? argv[2] : "../inst/test/rib.tst";
+
+  std::vector < rib_prefix > rib = read_rib(rib_path);
+  if (rib.empty()) {
+    fprintf(stderr, "no prefixes read from %s\n", rib_path);
+    return 1;
+  }
+
+  printf("suite,benchmark,workload,elements,seconds,elements_per_sec,peak_rss_kb\n");
+
+  // the CIDR index and interval table are built once, from the real prefixes
+  std::vector < std::pair < uint32_t, uint32_t > > index;
+  run("cidr_merge", "rib", rib.size(), [&]() {
+    for (size_t i = 0; i < rib.size(); i++) {
+      uint32_t first = (uint32_t) (uint128(0, rib[i].network) & cidr_net_mask(4, rib[i].length)).lo;
+      index.push_back(std::make_pair(first, first | (uint32_t) cidr_host_mask(4, rib[i].length).lo));
+    }
+    cidr_merge(index);
+    return (uint64_t) index.size();
+  });
+
+  interval_table table;
+  run("interval_table_build", "rib", rib.size(), [&]() {
+    std::vector < interval_table::entry > entries;
+    for (size_t i = 0; i < rib.size(); i++) {
+      uint128 first = uint128(0, rib[i].network) & cidr_net_mask(4, rib[i].length);
+      entries.push_back(interval_table::entry(first, first | cidr_host_mask(4, rib[i].length), rib[i].asn));
+    }
+    table.build(entries);
+    return (uint64_t) table.size();
+  });
+
+  for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+    const char *name = workloads[w].name;
+    std::mt19937 rng(seed);
+    std::vector < std::string > v4s = make_addresses(n, workloads[w].dirty, false, rng);
+    std::vector < std::string > v6s = make_addresses(n, workloads[w].dirty, true, rng);
+    std::vector < uint32_t > parsed(n);
+    std::vector < uint8_t > parsed_v6(16 * n);
+    std::vector < bool > valid_v6(n);
+
+    run("parse_ipv4", name, n, [&]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; i++) {
+        parsed[i] = 0;
+        sum += parse_ipv4(v4s[i].data(), v4s[i].size(), &parsed[i]) == IP_PARSE_OK;
+      }
+      return sum;
+    });
+
+    run("parse_ipv6", name, n, [&]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; i++) {
+        valid_v6[i] = parse_ipv6(v6s[i].data(), v6s[i].size(), &parsed_v6[16 * i]) == IP_PARSE_OK;
+        sum += valid_v6[i];
+      }
+      return sum;
+    });
+
+    run("format_ipv4", name, n, [&]() {
+      uint64_t sum = 0;
+      char buf[16];
+      for (size_t i = 0; i < n; i++) {
+        sum += format_ipv4(parsed[i], buf);
+      }
+      return sum;
+    });
+
+    run("format_ipv6", name, n, [&]() {
+      uint64_t sum = 0;
+      char buf[46];
+      for (size_t i = 0; i < n; i++) {
+        if (valid_v6[i]) {
+          sum += format_ipv6_compressed(&parsed_v6[16 * i], buf);
+        }
+      }
+      return sum;
+    });
+
+    run("cidr_index_contains", name, n, [&]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; i++) {
+        sum += cidr_index_contains(index, parsed[i]);
+      }
+      return sum;
+    });
+
+    run("interval_table_lookup", name, n, [&]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < n; i++) {
+        sum += table.lookup(uint128(0, parsed[i])) != interval_table::no_match;
+      }
+      return sum;
+    });
+
+    run("ip_radix_sort", name, n, [&]() {
+      std::vector < ip_sort_record < uint32_t > > records(n);
+      for (size_t i = 0; i < n; i++) {
+        records[i].key = parsed[i];
+        records[i].index = i;
+      }
+      ip_radix_sort(records);
+      return (uint64_t) records[n / 2].index;
+    });
+
+    // headers of one to four hops, built from the same addresses
+    std::vector < std::string > headers(n);
+    for (size_t i = 0; i < n; i++) {
+      headers[i] = v4s[i];
+      for (size_t hop = rng() % 4; hop > 0; hop--) {
+        headers[i] += ", " + v4s[(i + hop * 7919) % n];
+      }
+    }
+    run("xff_first_hop", name, n, [&]() {
+      uint64_t sum = 0;
+      size_t hop_len;
+      for (size_t i = 0; i < n; i++) {
+        sum += xff_first_hop(headers[i].data(), headers[i].size(), &hop_len) >= 0 ? hop_len : 0;
+      }
+      return sum;
+    });
+
+    run("cidr_decompose", name, n / 2, [&]() {
+      uint64_t blocks = 0;
+      for (size_t i = 0; i + 1 < n; i += 2) {
+        uint32_t a = parsed[i], b = parsed[i + 1];
+        cidr_decompose(uint128(0, a < b ? a : b), uint128(0, a < b ? b : a), 4,
+                       [&](const uint128&, int) { blocks++; });
+      }
+      return blocks;
+    });
+  }
+
+  return 0;
+}
@@ -10,6 +10,91 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// country_table_build
+SEXP country_table_build(List ranges);
+RcppExport SEXP _iptools_country_table_build(SEXP rangesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< List >::type ranges(rangesSEXP);
+    rcpp_result_gen = Rcpp::wrap(country_table_build(ranges));
+    return rcpp_result_gen;
+END_RCPP
+}
+// country_table_lookup
+IntegerVector country_table_lookup(SEXP tbl, SEXP ip_addresses);
+RcppExport SEXP _iptools_country_table_lookup(SEXP tblSEXP, SEXP ip_addressesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    rcpp_result_gen = Rcpp::wrap(country_table_lookup(tbl, ip_addresses));
+    return rcpp_result_gen;
+END_RCPP
+}
+// country_table_size
+NumericVector country_table_size(SEXP tbl);
+RcppExport SEXP _iptools_country_table_size(SEXP tblSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    rcpp_result_gen = Rcpp::wrap(country_table_size(tbl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// dns_cache_stats
+DataFrame dns_cache_stats();
+RcppExport SEXP _iptools_dns_cache_stats() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(dns_cache_stats());
+    return rcpp_result_gen;
+END_RCPP
+}
+// dns_cache_flush
+void dns_cache_flush();
+RcppExport SEXP _iptools_dns_cache_flush() {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    dns_cache_flush();
+    return R_NilValue;
+END_RCPP
+}
+// int_dns_cache_config
+DataFrame int_dns_cache_config(double max_entries, double positive_ttl, double negative_ttl);
+RcppExport SEXP _iptools_int_dns_cache_config(SEXP max_entriesSEXP, SEXP positive_ttlSEXP, SEXP negative_ttlSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< double >::type max_entries(max_entriesSEXP);
+    Rcpp::traits::input_parameter< double >::type positive_ttl(positive_ttlSEXP);
+    Rcpp::traits::input_parameter< double >::type negative_ttl(negative_ttlSEXP);
+    rcpp_result_gen = Rcpp::wrap(int_dns_cache_config(max_entries, positive_ttl, negative_ttl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// int_enrich_log
+double int_enrich_log(std::string input, std::string output, int column, int xff_column, std::vector < std::string > transforms, std::string sep, bool header, SEXP asn_table, int block_size);
+RcppExport SEXP _iptools_int_enrich_log(SEXP inputSEXP, SEXP outputSEXP, SEXP columnSEXP, SEXP xff_columnSEXP, SEXP transformsSEXP, SEXP sepSEXP, SEXP headerSEXP, SEXP asn_tableSEXP, SEXP block_sizeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type input(inputSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type column(columnSEXP);
+    Rcpp::traits::input_parameter< int >::type xff_column(xff_columnSEXP);
+    Rcpp::traits::input_parameter< std::vector < std::string > >::type transforms(transformsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type sep(sepSEXP);
+    Rcpp::traits::input_parameter< bool >::type header(headerSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type asn_table(asn_tableSEXP);
+    Rcpp::traits::input_parameter< int >::type block_size(block_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(int_enrich_log(input, output, column, xff_column, transforms, sep, header, asn_table, block_size));
+    return rcpp_result_gen;
+END_RCPP
+}
 // hilbert_encode
 NumericMatrix hilbert_encode(std::vector<unsigned> x, int bpp);
 RcppExport SEXP _iptools_hilbert_encode(SEXP xSEXP, SEXP bppSEXP) {
@@ -22,6 +107,91 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// hilbert_heatmap
+NumericMatrix hilbert_heatmap(SEXP x, int bpp, SEXP weights);
+RcppExport SEXP _iptools_hilbert_heatmap(SEXP xSEXP, SEXP bppSEXP, SEXP weightsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type bpp(bppSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type weights(weightsSEXP);
+    rcpp_result_gen = Rcpp::wrap(hilbert_heatmap(x, bpp, weights));
+    return rcpp_result_gen;
+END_RCPP
+}
+// hilbert_decode
+CharacterVector hilbert_decode(NumericVector x, NumericVector y, int bpp);
+RcppExport SEXP _iptools_hilbert_decode(SEXP xSEXP, SEXP ySEXP, SEXP bppSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< int >::type bpp(bppSEXP);
+    rcpp_result_gen = Rcpp::wrap(hilbert_decode(x, y, bpp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// iana_table_build
+SEXP iana_table_build(CharacterVector special_blocks, CharacterVector registry_blocks);
+RcppExport SEXP _iptools_iana_table_build(SEXP special_blocksSEXP, SEXP registry_blocksSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type special_blocks(special_blocksSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type registry_blocks(registry_blocksSEXP);
+    rcpp_result_gen = Rcpp::wrap(iana_table_build(special_blocks, registry_blocks));
+    return rcpp_result_gen;
+END_RCPP
+}
+// iana_table_lookup
+List iana_table_lookup(SEXP tbl, SEXP ip_addresses);
+RcppExport SEXP _iptools_iana_table_lookup(SEXP tblSEXP, SEXP ip_addressesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    rcpp_result_gen = Rcpp::wrap(iana_table_lookup(tbl, ip_addresses));
+    return rcpp_result_gen;
+END_RCPP
+}
+// iana_table_size
+NumericVector iana_table_size(SEXP tbl);
+RcppExport SEXP _iptools_iana_table_size(SEXP tblSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    rcpp_result_gen = Rcpp::wrap(iana_table_size(tbl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ip_order
+SEXP ip_order(SEXP ip_addresses, bool decreasing);
+RcppExport SEXP _iptools_ip_order(SEXP ip_addressesSEXP, SEXP decreasingSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< bool >::type decreasing(decreasingSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_order(ip_addresses, decreasing));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ip_sort
+SEXP ip_sort(SEXP ip_addresses, bool decreasing);
+RcppExport SEXP _iptools_ip_sort(SEXP ip_addressesSEXP, SEXP decreasingSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< bool >::type decreasing(decreasingSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_sort(ip_addresses, decreasing));
+    return rcpp_result_gen;
+END_RCPP
+}
 // int_ip_to_subnet
 StringVector int_ip_to_subnet(StringVector ip_addresses, IntegerVector prefix_lengths);
 RcppExport SEXP _iptools_int_ip_to_subnet(SEXP ip_addressesSEXP, SEXP prefix_lengthsSEXP) {
@@ -35,28 +205,135 @@ BEGIN_RCPP
 END_RCPP
 }
 // ipv6_to_bytes
-List ipv6_to_bytes(std::vector < std::string > input);
-RcppExport SEXP _iptools_ipv6_to_bytes(SEXP inputSEXP) {
+SEXP ipv6_to_bytes(CharacterVector input, bool matrix);
+RcppExport SEXP _iptools_ipv6_to_bytes(SEXP inputSEXP, SEXP matrixSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type input(inputSEXP);
+    Rcpp::traits::input_parameter< bool >::type matrix(matrixSEXP);
+    rcpp_result_gen = Rcpp::wrap(ipv6_to_bytes(input, matrix));
+    return rcpp_result_gen;
+END_RCPP
+}
+// int_ip_to_subnet_numeric
+NumericVector int_ip_to_subnet_numeric(SEXP ip_addresses, IntegerVector prefix_lengths);
+RcppExport SEXP _iptools_int_ip_to_subnet_numeric(SEXP ip_addressesSEXP, SEXP prefix_lengthsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type prefix_lengths(prefix_lengthsSEXP);
+    rcpp_result_gen = Rcpp::wrap(int_ip_to_subnet_numeric(ip_addresses, prefix_lengths));
+    return rcpp_result_gen;
+END_RCPP
+}
+// subnet_counts
+DataFrame subnet_counts(SEXP ip_addresses, int prefix_length);
+RcppExport SEXP _iptools_subnet_counts(SEXP ip_addressesSEXP, SEXP prefix_lengthSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type input(inputSEXP);
-    rcpp_result_gen = Rcpp::wrap(ipv6_to_bytes(input));
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< int >::type prefix_length(prefix_lengthSEXP);
+    rcpp_result_gen = Rcpp::wrap(subnet_counts(ip_addresses, prefix_length));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ip_count
+DataFrame ip_count(SEXP ip_addresses, bool sort);
+RcppExport SEXP _iptools_ip_count(SEXP ip_addressesSEXP, SEXP sortSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< bool >::type sort(sortSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_count(ip_addresses, sort));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ip_distinct
+SEXP ip_distinct(SEXP ip_addresses);
+RcppExport SEXP _iptools_ip_distinct(SEXP ip_addressesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_distinct(ip_addresses));
     return rcpp_result_gen;
 END_RCPP
 }
 // range_boundaries_to_cidr
-std::vector < std::string > range_boundaries_to_cidr(long int ip_start, long int ip_end);
+CharacterVector range_boundaries_to_cidr(SEXP ip_start, SEXP ip_end);
 RcppExport SEXP _iptools_range_boundaries_to_cidr(SEXP ip_startSEXP, SEXP ip_endSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< long int >::type ip_start(ip_startSEXP);
-    Rcpp::traits::input_parameter< long int >::type ip_end(ip_endSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_start(ip_startSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_end(ip_endSEXP);
     rcpp_result_gen = Rcpp::wrap(range_boundaries_to_cidr(ip_start, ip_end));
     return rcpp_result_gen;
 END_RCPP
 }
+// cidr_decompose
+DataFrame cidr_decompose(SEXP ip_start, SEXP ip_end);
+RcppExport SEXP _iptools_cidr_decompose(SEXP ip_startSEXP, SEXP ip_endSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_start(ip_startSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_end(ip_endSEXP);
+    rcpp_result_gen = Rcpp::wrap(cidr_decompose(ip_start, ip_end));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cidr_collapse
+CharacterVector cidr_collapse(CharacterVector cidrs);
+RcppExport SEXP _iptools_cidr_collapse(SEXP cidrsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type cidrs(cidrsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cidr_collapse(cidrs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cidr_union
+CharacterVector cidr_union(CharacterVector x, CharacterVector y);
+RcppExport SEXP _iptools_cidr_union(SEXP xSEXP, SEXP ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cidr_union(x, y));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cidr_intersect
+CharacterVector cidr_intersect(CharacterVector x, CharacterVector y);
+RcppExport SEXP _iptools_cidr_intersect(SEXP xSEXP, SEXP ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cidr_intersect(x, y));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cidr_setdiff
+CharacterVector cidr_setdiff(CharacterVector x, CharacterVector y);
+RcppExport SEXP _iptools_cidr_setdiff(SEXP xSEXP, SEXP ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type y(ySEXP);
+    rcpp_result_gen = Rcpp::wrap(cidr_setdiff(x, y));
+    return rcpp_result_gen;
+END_RCPP
+}
 // hostname_to_ip
 std::list < std::vector < std::string > > hostname_to_ip(std::vector < std::string > hostnames);
 RcppExport SEXP _iptools_hostname_to_ip(SEXP hostnamesSEXP) {
@@ -79,46 +356,72 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// hostname_to_ip_async
+DataFrame hostname_to_ip_async(CharacterVector hostnames, int concurrency, double timeout);
+RcppExport SEXP _iptools_hostname_to_ip_async(SEXP hostnamesSEXP, SEXP concurrencySEXP, SEXP timeoutSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type hostnames(hostnamesSEXP);
+    Rcpp::traits::input_parameter< int >::type concurrency(concurrencySEXP);
+    Rcpp::traits::input_parameter< double >::type timeout(timeoutSEXP);
+    rcpp_result_gen = Rcpp::wrap(hostname_to_ip_async(hostnames, concurrency, timeout));
+    return rcpp_result_gen;
+END_RCPP
+}
+// ip_to_hostname_async
+DataFrame ip_to_hostname_async(CharacterVector ip_addresses, int concurrency, double timeout);
+RcppExport SEXP _iptools_ip_to_hostname_async(SEXP ip_addressesSEXP, SEXP concurrencySEXP, SEXP timeoutSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< int >::type concurrency(concurrencySEXP);
+    Rcpp::traits::input_parameter< double >::type timeout(timeoutSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_to_hostname_async(ip_addresses, concurrency, timeout));
+    return rcpp_result_gen;
+END_RCPP
+}
 // ip_to_numeric
-std::vector < unsigned int > ip_to_numeric(std::vector < std::string > ip_addresses);
+NumericVector ip_to_numeric(CharacterVector ip_addresses);
 RcppExport SEXP _iptools_ip_to_numeric(SEXP ip_addressesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
     rcpp_result_gen = Rcpp::wrap(ip_to_numeric(ip_addresses));
     return rcpp_result_gen;
 END_RCPP
 }
 // v6_scope
-std::vector < unsigned long > v6_scope(std::vector < std::string > ip_addresses);
+NumericVector v6_scope(CharacterVector ip_addresses);
 RcppExport SEXP _iptools_v6_scope(SEXP ip_addressesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
     rcpp_result_gen = Rcpp::wrap(v6_scope(ip_addresses));
     return rcpp_result_gen;
 END_RCPP
 }
 // expand_ipv6
-std::vector < std::string > expand_ipv6(std::vector < std::string > ip_addresses);
+SEXP expand_ipv6(CharacterVector ip_addresses);
 RcppExport SEXP _iptools_expand_ipv6(SEXP ip_addressesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
     rcpp_result_gen = Rcpp::wrap(expand_ipv6(ip_addresses));
     return rcpp_result_gen;
 END_RCPP
 }
 // numeric_to_ip
-std::vector < std::string > numeric_to_ip(std::vector < unsigned int > ip_addresses);
+SEXP numeric_to_ip(NumericVector ip_addresses);
 RcppExport SEXP _iptools_numeric_to_ip(SEXP ip_addressesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < unsigned int > >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type ip_addresses(ip_addressesSEXP);
     rcpp_result_gen = Rcpp::wrap(numeric_to_ip(ip_addresses));
     return rcpp_result_gen;
 END_RCPP
@@ -135,60 +438,61 @@ BEGIN_RCPP
 END_RCPP
 }
 // range_boundaries
-DataFrame range_boundaries(std::vector < std::string > ranges);
+DataFrame range_boundaries(CharacterVector ranges);
 RcppExport SEXP _iptools_range_boundaries(SEXP rangesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ranges(rangesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ranges(rangesSEXP);
     rcpp_result_gen = Rcpp::wrap(range_boundaries(ranges));
     return rcpp_result_gen;
 END_RCPP
 }
 // ip_in_range
-std::vector < bool > ip_in_range(std::vector < std::string > ip_addresses, std::vector < std::string > ranges);
+LogicalVector ip_in_range(CharacterVector ip_addresses, CharacterVector ranges);
 RcppExport SEXP _iptools_ip_in_range(SEXP ip_addressesSEXP, SEXP rangesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ranges(rangesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ranges(rangesSEXP);
     rcpp_result_gen = Rcpp::wrap(ip_in_range(ip_addresses, ranges));
     return rcpp_result_gen;
 END_RCPP
 }
 // ip_in_any
-std::vector < bool > ip_in_any(std::vector < std::string > ip_addresses, std::vector < std::string > ranges);
+LogicalVector ip_in_any(CharacterVector ip_addresses, CharacterVector ranges);
 RcppExport SEXP _iptools_ip_in_any(SEXP ip_addressesSEXP, SEXP rangesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ranges(rangesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ranges(rangesSEXP);
     rcpp_result_gen = Rcpp::wrap(ip_in_any(ip_addresses, ranges));
     return rcpp_result_gen;
 END_RCPP
 }
 // validate_range
-std::vector < bool > validate_range(std::vector < std::string > ranges);
+LogicalVector validate_range(CharacterVector ranges);
 RcppExport SEXP _iptools_validate_range(SEXP rangesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ranges(rangesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type ranges(rangesSEXP);
     rcpp_result_gen = Rcpp::wrap(validate_range(ranges));
     return rcpp_result_gen;
 END_RCPP
 }
 // xff_extract
-std::vector < std::string > xff_extract(std::vector < std::string > ip_addresses, std::vector < std::string > x_forwarded_for);
-RcppExport SEXP _iptools_xff_extract(SEXP ip_addressesSEXP, SEXP x_forwarded_forSEXP) {
+CharacterVector xff_extract(CharacterVector ip_addresses, CharacterVector x_forwarded_for, CharacterVector trusted_proxies);
+RcppExport SEXP _iptools_xff_extract(SEXP ip_addressesSEXP, SEXP x_forwarded_forSEXP, SEXP trusted_proxiesSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type ip_addresses(ip_addressesSEXP);
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type x_forwarded_for(x_forwarded_forSEXP);
-    rcpp_result_gen = Rcpp::wrap(xff_extract(ip_addresses, x_forwarded_for));
+    Rcpp::traits::input_parameter< CharacterVector >::type ip_addresses(ip_addressesSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type x_forwarded_for(x_forwarded_forSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type trusted_proxies(trusted_proxiesSEXP);
+    rcpp_result_gen = Rcpp::wrap(xff_extract(ip_addresses, x_forwarded_for, trusted_proxies));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -204,35 +508,172 @@ BEGIN_RCPP
 END_RCPP
 }
 // ip_numeric_to_binary_string
-CharacterVector ip_numeric_to_binary_string(std::vector < unsigned int > input);
+CharacterVector ip_numeric_to_binary_string(NumericVector input);
 RcppExport SEXP _iptools_ip_numeric_to_binary_string(SEXP inputSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < unsigned int > >::type input(inputSEXP);
+    Rcpp::traits::input_parameter< NumericVector >::type input(inputSEXP);
     rcpp_result_gen = Rcpp::wrap(ip_numeric_to_binary_string(input));
     return rcpp_result_gen;
 END_RCPP
 }
 // ip_to_binary_string
-CharacterVector ip_to_binary_string(std::vector < std::string > input);
+CharacterVector ip_to_binary_string(CharacterVector input);
 RcppExport SEXP _iptools_ip_to_binary_string(SEXP inputSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< std::vector < std::string > >::type input(inputSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type input(inputSEXP);
     rcpp_result_gen = Rcpp::wrap(ip_to_binary_string(input));
     return rcpp_result_gen;
 END_RCPP
 }
+// ip_pack
+SEXP ip_pack(SEXP ip_addresses);
+RcppExport SEXP _iptools_ip_pack(SEXP ip_addressesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    rcpp_result_gen = Rcpp::wrap(ip_pack(ip_addresses));
+    return rcpp_result_gen;
+END_RCPP
+}
+// int_range_generate
+SEXP int_range_generate(CharacterVector range);
+RcppExport SEXP _iptools_int_range_generate(SEXP rangeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< CharacterVector >::type range(rangeSEXP);
+    rcpp_result_gen = Rcpp::wrap(int_range_generate(range));
+    return rcpp_result_gen;
+END_RCPP
+}
+// int_ip_sequence_slice
+SEXP int_ip_sequence_slice(SEXP x, double from, double n);
+RcppExport SEXP _iptools_int_ip_sequence_slice(SEXP xSEXP, SEXP fromSEXP, SEXP nSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< double >::type n(nSEXP);
+    rcpp_result_gen = Rcpp::wrap(int_ip_sequence_slice(x, from, n));
+    return rcpp_result_gen;
+END_RCPP
+}
+// prefix_table_build
+SEXP prefix_table_build(SEXP networks, IntegerVector lengths, CharacterVector values);
+RcppExport SEXP _iptools_prefix_table_build(SEXP networksSEXP, SEXP lengthsSEXP, SEXP valuesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type networks(networksSEXP);
+    Rcpp::traits::input_parameter< IntegerVector >::type lengths(lengthsSEXP);
+    Rcpp::traits::input_parameter< CharacterVector >::type values(valuesSEXP);
+    rcpp_result_gen = Rcpp::wrap(prefix_table_build(networks, lengths, values));
+    return rcpp_result_gen;
+END_RCPP
+}
+// prefix_table_lookup
+CharacterVector prefix_table_lookup(SEXP tbl, SEXP ip_addresses);
+RcppExport SEXP _iptools_prefix_table_lookup(SEXP tblSEXP, SEXP ip_addressesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type ip_addresses(ip_addressesSEXP);
+    rcpp_result_gen = Rcpp::wrap(prefix_table_lookup(tbl, ip_addresses));
+    return rcpp_result_gen;
+END_RCPP
+}
+// prefix_table_size
+double prefix_table_size(SEXP tbl);
+RcppExport SEXP _iptools_prefix_table_size(SEXP tblSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    rcpp_result_gen = Rcpp::wrap(prefix_table_size(tbl));
+    return rcpp_result_gen;
+END_RCPP
+}
+// prefix_table_write
+void prefix_table_write(SEXP tbl, std::string path);
+RcppExport SEXP _iptools_prefix_table_write(SEXP tblSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type tbl(tblSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    prefix_table_write(tbl, path);
+    return R_NilValue;
+END_RCPP
+}
+// prefix_table_read
+SEXP prefix_table_read(std::string path);
+RcppExport SEXP _iptools_prefix_table_read(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(prefix_table_read(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// iptools_stats
+DataFrame iptools_stats();
+RcppExport SEXP _iptools_iptools_stats() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(iptools_stats());
+    return rcpp_result_gen;
+END_RCPP
+}
+// iptools_stats_reset
+void iptools_stats_reset();
+RcppExport SEXP _iptools_iptools_stats_reset() {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    iptools_stats_reset();
+    return R_NilValue;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_iptools_country_table_build", (DL_FUNC) &_iptools_country_table_build, 1},
+    {"_iptools_country_table_lookup", (DL_FUNC) &_iptools_country_table_lookup, 2},
+    {"_iptools_country_table_size", (DL_FUNC) &_iptools_country_table_size, 1},
+    {"_iptools_dns_cache_stats", (DL_FUNC) &_iptools_dns_cache_stats, 0},
+    {"_iptools_dns_cache_flush", (DL_FUNC) &_iptools_dns_cache_flush, 0},
+    {"_iptools_int_dns_cache_config", (DL_FUNC) &_iptools_int_dns_cache_config, 3},
+    {"_iptools_int_enrich_log", (DL_FUNC) &_iptools_int_enrich_log, 9},
     {"_iptools_hilbert_encode", (DL_FUNC) &_iptools_hilbert_encode, 2},
+    {"_iptools_hilbert_heatmap", (DL_FUNC) &_iptools_hilbert_heatmap, 3},
+    {"_iptools_hilbert_decode", (DL_FUNC) &_iptools_hilbert_decode, 3},
+    {"_iptools_iana_table_build", (DL_FUNC) &_iptools_iana_table_build, 2},
+    {"_iptools_iana_table_lookup", (DL_FUNC) &_iptools_iana_table_lookup, 2},
+    {"_iptools_iana_table_size", (DL_FUNC) &_iptools_iana_table_size, 1},
+    {"_iptools_ip_order", (DL_FUNC) &_iptools_ip_order, 2},
+    {"_iptools_ip_sort", (DL_FUNC) &_iptools_ip_sort, 2},
     {"_iptools_int_ip_to_subnet", (DL_FUNC) &_iptools_int_ip_to_subnet, 2},
-    {"_iptools_ipv6_to_bytes", (DL_FUNC) &_iptools_ipv6_to_bytes, 1},
+    {"_iptools_ipv6_to_bytes", (DL_FUNC) &_iptools_ipv6_to_bytes, 2},
+    {"_iptools_int_ip_to_subnet_numeric", (DL_FUNC) &_iptools_int_ip_to_subnet_numeric, 2},
+    {"_iptools_subnet_counts", (DL_FUNC) &_iptools_subnet_counts, 2},
+    {"_iptools_ip_count", (DL_FUNC) &_iptools_ip_count, 2},
+    {"_iptools_ip_distinct", (DL_FUNC) &_iptools_ip_distinct, 1},
     {"_iptools_range_boundaries_to_cidr", (DL_FUNC) &_iptools_range_boundaries_to_cidr, 2},
+    {"_iptools_cidr_decompose", (DL_FUNC) &_iptools_cidr_decompose, 2},
+    {"_iptools_cidr_collapse", (DL_FUNC) &_iptools_cidr_collapse, 1},
+    {"_iptools_cidr_union", (DL_FUNC) &_iptools_cidr_union, 2},
+    {"_iptools_cidr_intersect", (DL_FUNC) &_iptools_cidr_intersect, 2},
+    {"_iptools_cidr_setdiff", (DL_FUNC) &_iptools_cidr_setdiff, 2},
     {"_iptools_hostname_to_ip", (DL_FUNC) &_iptools_hostname_to_ip, 1},
     {"_iptools_ip_to_hostname", (DL_FUNC) &_iptools_ip_to_hostname, 1},
+    {"_iptools_hostname_to_ip_async", (DL_FUNC) &_iptools_hostname_to_ip_async, 3},
+    {"_iptools_ip_to_hostname_async", (DL_FUNC) &_iptools_ip_to_hostname_async, 3},
     {"_iptools_ip_to_numeric", (DL_FUNC) &_iptools_ip_to_numeric, 1},
     {"_iptools_v6_scope", (DL_FUNC) &_iptools_v6_scope, 1},
     {"_iptools_expand_ipv6", (DL_FUNC) &_iptools_expand_ipv6, 1},
@@ -242,14 +683,26 @@ static const R_CallMethodDef CallEntries[] = {
     {"_iptools_ip_in_range", (DL_FUNC) &_iptools_ip_in_range, 2},
     {"_iptools_ip_in_any", (DL_FUNC) &_iptools_ip_in_any, 2},
     {"_iptools_validate_range", (DL_FUNC) &_iptools_validate_range, 1},
-    {"_iptools_xff_extract", (DL_FUNC) &_iptools_xff_extract, 2},
+    {"_iptools_xff_extract", (DL_FUNC) &_iptools_xff_extract, 3},
     {"_iptools_is_multicast", (DL_FUNC) &_iptools_is_multicast, 1},
     {"_iptools_ip_numeric_to_binary_string", (DL_FUNC) &_iptools_ip_numeric_to_binary_string, 1},
     {"_iptools_ip_to_binary_string", (DL_FUNC) &_iptools_ip_to_binary_string, 1},
+    {"_iptools_ip_pack", (DL_FUNC) &_iptools_ip_pack, 1},
+    {"_iptools_int_range_generate", (DL_FUNC) &_iptools_int_range_generate, 1},
+    {"_iptools_int_ip_sequence_slice", (DL_FUNC) &_iptools_int_ip_sequence_slice, 3},
+    {"_iptools_prefix_table_build", (DL_FUNC) &_iptools_prefix_table_build, 3},
+    {"_iptools_prefix_table_lookup", (DL_FUNC) &_iptools_prefix_table_lookup, 2},
+    {"_iptools_prefix_table_size", (DL_FUNC) &_iptools_prefix_table_size, 1},
+    {"_iptools_prefix_table_write", (DL_FUNC) &_iptools_prefix_table_write, 2},
+    {"_iptools_prefix_table_read", (DL_FUNC) &_iptools_prefix_table_read, 1},
+    {"_iptools_iptools_stats", (DL_FUNC) &_iptools_iptools_stats, 0},
+    {"_iptools_iptools_stats_reset", (DL_FUNC) &_iptools_iptools_stats_reset, 0},
     {NULL, NULL, 0}
 };
 
+void packed_ip_init(DllInfo* dll);
 RcppExport void R_init_iptools(DllInfo *dll) {
     R_registerRoutines(dll, NULL, CallEntries, NULL, NULL);
     R_useDynamicSymbols(dll, FALSE);
+    packed_ip_init(dll);
 }
@@ -3,6 +3,7 @@
 
 #include <Rcpp.h>
 #include <stdio.h>
+#include <chrono>
 
 // #ifdef __APPLE__
 // #pragma clang diagnostic push
@@ -15,152 +16,26 @@
 // #endif
 
 #include "asio_bindings.h"
+#include "dns_cache.h"
+#include "ip_parse.h"
+#include "packed_ip.h"
+#include "parallel.h"
+#include "stats.h"
 
 using namespace Rcpp;
 
-#ifdef WIN64
-#define IS_WINDOWS
-#elif defined WIN32
-#define IS_WINDOWS
-#endif
-
-#ifdef IS_WINDOWS
-/* https://stackoverflow.com/questions/15370033/how-to-use-inet-pton-with-the-mingw-compiler */
-#define NS_INADDRSZ  4
-#define NS_IN6ADDRSZ 16
-#define NS_INT16SZ   2
-
-int inet_pton4(const char *src, unsigned int *dst) {
-  uint8_t tmp[NS_INADDRSZ], *tp;
-
-  int saw_digit = 0;
-  int octets = 0;
-  *(tp = tmp) = 0;
-
-  int ch;
-  while ((ch = *src++) != '\0') {
-    if (ch >= '0' && ch <= '9') {
-      uint32_t n = *tp * 10 + (ch - '0');
-
-      if (saw_digit && *tp == 0) return 0;
-
-      if (n > 255) return 0;
-
-      *tp = n;
-      if (!saw_digit) {
-        if (++octets > 4) return 0;
-        saw_digit = 1;
-      }
-
-    } else if (ch == '.' && saw_digit) {
-      if (octets == 4) return 0;
-      *++tp = 0;
-      saw_digit = 0;
-    } else return 0;
-  }
-  if (octets < 4) return 0;
-
-  memcpy(dst, tmp, NS_INADDRSZ);
-  return 1;
-}
-
-int inet_pton6(const char *src, unsigned int *dst) {
-    static const char xdigits[] = "0123456789abcdef";
-    uint8_t tmp[NS_IN6ADDRSZ];
-
-    uint8_t *tp = (uint8_t*) memset(tmp, '\0', NS_IN6ADDRSZ);
-    uint8_t *endp = tp + NS_IN6ADDRSZ;
-    uint8_t *colonp = NULL;
-
-    /* Leading :: requires some special handling. */
-    if (*src == ':') {
-        if (*++src != ':') return 0;
-    }
-
-    const char *curtok = src;
-    int saw_xdigit = 0;
-    uint32_t val = 0;
-    int ch;
-    while ((ch = tolower(*src++)) != '\0') {
-        const char *pch = strchr(xdigits, ch);
-        if (pch != NULL) {
-            val <<= 4;
-            val |= (pch - xdigits);
-            if (val > 0xffff)
-                return 0;
-            saw_xdigit = 1;
-            continue;
-        }
-        if (ch == ':') {
-            curtok = src;
-            if (!saw_xdigit) {
-                if (colonp)
-                    return 0;
-                colonp = tp;
-                continue;
-            } else if (*src == '\0') {
-                return 0;
-            }
-            if (tp + NS_INT16SZ > endp) return 0;
-            *tp++ = (uint8_t) (val >> 8) & 0xff;
-            *tp++ = (uint8_t) val & 0xff;
-            saw_xdigit = 0;
-            val = 0;
-            continue;
-        }
-        if (ch == '.' && ((tp + NS_INADDRSZ) <= endp) &&
-                inet_pton4(curtok, (unsigned int*) tp) > 0) {
-            tp += NS_INADDRSZ;
-            saw_xdigit = 0;
-            break; /* '\0' was seen by inet_pton4(). */
-        }
-        return 0;
-    }
-    if (saw_xdigit) {
-        if (tp + NS_INT16SZ > endp)
-            return 0;
-        *tp++ = (uint8_t) (val >> 8) & 0xff;
-        *tp++ = (uint8_t) val & 0xff;
-    }
-    if (colonp != NULL) {
-        /*
-         * Since some memmove()'s erroneously fail to handle
-         * overlapping regions, we'll do the shift by hand.
-         */
-        const int n = tp - colonp;
-
-        if (tp == endp)
-            return 0;
-
-        for (int i = 1; i <= n; i++) {
-            endp[-i] = colonp[n - i];
-            colonp[n - i] = 0;
-        }
-        tp = endp;
-    }
-    if (tp != endp)
-        return 0;
-
-    memcpy(dst, tmp, NS_IN6ADDRSZ);
-
-    return 1;
-}
-
-int inet_pton(int af, const char *src, unsigned int *dst){
-  switch (af) {
-  case AF_INET:
-    return inet_pton4(src, dst);
-  case AF_INET6:
-    return inet_pton6(src, dst);
-  default:
-    return -1;
-  }
-}
-#endif
-
 std::vector < std::string > asio_bindings::single_hostname_to_dns(std::string hostname,
                                                                   asio::ip::tcp::resolver& resolver_ptr){
   std::vector < std::string > output;
+  std::string key = dns_cache::forward_key(hostname);
+  bool negative;
+
+  if(dns_cache::instance().lookup(key, output, negative)){
+    if(negative){
+      output.assign(1, "Not resolved");
+    }
+    return output;
+  }
 
   try{
     asio::ip::tcp::resolver::query query(hostname, "");
@@ -172,7 +47,10 @@ std::vector < std::string > asio_bindings::single_hostname_to_dns(std::string ho
       endpoint = *destination++;
       output.push_back(endpoint.address().to_string());
     }
+    dns_cache::instance().store(key, output, false);
   } catch(...){
+    stats_exception(STATS_HOSTNAME_TO_IP);
+    dns_cache::instance().store(key, output, true);
     output.push_back("Not resolved");
   }
 
@@ -183,6 +61,7 @@ std::list < std::vector < std::string > > asio_bindings::multi_hostname_to_dns(s
 
   unsigned int in_size = hostnames.size();
   std::list < std::vector < std::string > > output;
+  stats_call stats(STATS_HOSTNAME_TO_IP, in_size);
   std::vector < std::string > holding;
   try{
     asio::ip::tcp::resolver dns_resolver(io_service);
@@ -207,6 +86,15 @@ std::vector < std::string > asio_bindings::single_ip_to_dns(std::string ip_addre
                                                           asio::ip::tcp::resolver& resolver_ptr){
   std::vector < std::string > output;
   asio::ip::tcp::endpoint endpoint;
+  std::string key = dns_cache::reverse_key(ip_address);
+  bool negative;
+
+  if(dns_cache::instance().lookup(key, output, negative)){
+    if(negative){
+      output.assign(1, "Invalid IP address");
+    }
+    return output;
+  }
 
   try{
 
@@ -217,128 +105,58 @@ std::vector < std::string > asio_bindings::single_ip_to_dns(std::string ip_addre
     for (int i=1; destination != end; destination++, i++) {
       output.push_back(destination->host_name());
     }
+    dns_cache::instance().store(key, output, false);
 
   } catch(...){
+    stats_exception(STATS_IP_TO_HOSTNAME);
+    dns_cache::instance().store(key, output, true);
     output.push_back("Invalid IP address");
   }
 
   return output;
 }
 
-bool asio_bindings::single_ip_in_range(std::string ip_address, std::string range){
+int asio_bindings::range_mask(const char* range, size_t range_len, uint128& network, uint128& mask){
 
-  unsigned int first_ip, mask;
   int slash_val;
-  char range_copy[24];
-  char *slash_pos;
-  bool output = false;
-
-  int sz = strnlen(range.c_str(), 23);
-
-  // safe'r' copy according to CRAN & gcc-8
-  memcpy(&range_copy[0], range.c_str(), sz);
-  range_copy[sz] = '\0';
-  // strncpy(range_copy, range.c_str(), 24); // safe copy
-  slash_pos = strchr(range_copy, '/'); // find the "/"
-
-  if(slash_pos == NULL){
-    return output;
-  }
-
-  *slash_pos++ = '\0';
-
-  try{
-
-    slash_val = atoi(slash_pos);
-    first_ip = asio::ip::address_v4::from_string(std::string(range_copy)).to_ulong();
-    // shifting by 32 bits is undefined
-    mask = slash_val == 32 ? 0xffffffff : ~(0xffffffff >> slash_val);
-    unsigned int cidr_int = first_ip & mask ;
+  int family = cidr_parse(range, range_len, &network, &slash_val);
 
-    output = ((asio::ip::address_v4::from_string(ip_address).to_ulong() & mask) == cidr_int);
-
-  } catch(...){
-    output = false;
+  if (family) {
+    mask = cidr_net_mask(family, slash_val);
+    network = network & mask;
   }
 
-  return output;
+  return family;
 }
 
-std::vector < std::string > asio_bindings::calculate_ip_range(std::string range){
+int asio_bindings::ip_range_bounds(const char* range, size_t range_len, uint128& first_ip, uint128& last_ip){
 
-  unsigned int first_ip, last_ip;
   int slash_val;
-  char cidr_copy[24];
-  char *slash_pos;
-  std::vector < std::string > output;
-
-  int sz = strnlen(range.c_str(), 23);
+  int family = cidr_parse(range, range_len, &first_ip, &slash_val);
 
-  // safe'r' copy according to CRAN & gcc-8
-  memcpy(&cidr_copy[0], range.c_str(), sz);
-  cidr_copy[sz] = '\0';
-  // strncpy(cidr_copy, range.c_str(), 24);
-  slash_pos = strchr(cidr_copy, '/');
-  if (slash_pos == NULL){
-    output.push_back("Invalid");
-    output.push_back("Invalid");
-  } else {
-    *slash_pos++ = '\0';
-    slash_val = atoi(slash_pos);
-
-    if (1 != inet_pton(AF_INET, cidr_copy, &first_ip)) {
-      output.push_back("Invalid");
-      output.push_back("Invalid");
-    } else {
-      first_ip = ntohl(first_ip);
-      unsigned int mask = ~0;
-
-      if (slash_val < 32)  {
-        last_ip = first_ip | (mask >> slash_val);
-      } else { // special case where CIDR mask was 32 (a single IPv4)
-        last_ip = first_ip;
-      }
-      output.push_back(asio::ip::address_v4(first_ip).to_string());
-      output.push_back(asio::ip::address_v4(last_ip).to_string());
-    }
+  if (!family || slash_val < 0) {
+    return 0;
   }
 
-  return output;
-}
-
-bool asio_bindings::validate_single_range(std::string range){
-  bool output = false;
-  size_t slash_loc = range.find("/");
-  std::string holding;
-  long int range_val;
-  asio::ip::address converted_ip;
+  // a prefix of the full address width (or more) is a single address
+  last_ip = first_ip | cidr_host_mask(family, slash_val);
 
-  if(slash_loc == std::string::npos){
-    return output;
-  }
-  holding = range.substr(slash_loc+1);
-  range = range.substr(0,slash_loc);
+  return family;
+}
 
-  try{
+bool asio_bindings::validate_single_range(const char* range, size_t range_len){
+  uint128 address;
+  int range_val;
+  int family = cidr_parse(range, range_len, &address, &range_val);
 
-    converted_ip = asio::ip::address::from_string(range);
-    if(!converted_ip.is_v4()){
-      return output;
-    }
-    range_val = atoi(holding.c_str());
-    if(range_val >= 1 && range_val <= 32){
-      output = true;
-    }
-  } catch(...){
-    return output;
-  }
-
-  return output;
+  return family && range_val >= 1 && range_val <= cidr_bits(family);
 }
+
 std::list < std::vector < std::string > > asio_bindings::multi_ip_to_dns(std::vector < std::string > ip_addresses){
 
   std::list < std::vector < std::string > > output;
   std::vector < std::string > holding;
+  stats_call stats(STATS_IP_TO_HOSTNAME, ip_addresses.size());
   try{
 
     asio::ip::tcp::resolver dns_resolver(io_service);
@@ -358,299 +176,826 @@ std::list < std::vector < std::string > > asio_bindings::multi_ip_to_dns(std::ve
   return output;
 }
 
-std::vector < std::string > asio_bindings::expand_ipv6_(std::vector < std::string > ip_addresses) {
+/**
+ * One in-flight lookup slot for resolve_async. Each lane has its own
+ * io_service (and so its own resolver thread), because asio runs the
+ * lookups on a single io_service one at a time.
+ */
+struct dns_lane {
+  asio::io_service service;
+  asio::ip::tcp::resolver resolver;
+  R_xlen_t query;
+  bool done;
+  bool timed_out;
+  asio::error_code error;
+  std::vector < std::string > answers;
+
+#ifdef IPTOOLS_DNS_STUB
+  /**
+   * Stands in for the resolver thread in stub builds; see dns_stub_delay.
+   */
+  std::thread stub;
+
+  ~dns_lane(){
+    if(stub.joinable()){
+      stub.join();
+    }
+  }
+#endif
 
-  unsigned int input_size = ip_addresses.size();
-  std::vector < std::string > output(input_size);
-  asio::ip::address_v6::bytes_type v;
-  char str[50];
+  dns_lane() : resolver(service), query(-1), done(false), timed_out(false) {}
+};
+
+/**
+ * A test hook, compiled in only when IPTOOLS_DNS_STUB is defined (add
+ * -DIPTOOLS_DNS_STUB to PKG_CPPFLAGS in ~/.R/Makevars): read the
+ * iptools.dns_stub option.
+ *
+ * @return a negative number (the default, and always in release builds) to
+ * use the system resolver, or the number of seconds a stub lookup should
+ * take instead. Stub lookups never touch the network or the cache: forward
+ * lookups answer "192.0.2.1" and reverse ones "stub.invalid".
+ */
+static double dns_stub_delay(){
+#ifndef IPTOOLS_DNS_STUB
+  return -1;
+#else
+  SEXP option = Rf_GetOption1(Rf_install("iptools.dns_stub"));
+  if(Rf_isNull(option) || Rf_length(option) < 1){
+    return -1;
+  }
+  double delay = Rf_asReal(option);
+  return ISNAN(delay) || delay < 0 ? -1 : delay;
+#endif
+}
 
-  for(unsigned int i = 0; i < input_size; i++){
-    if((i % 10000) == 0){
+/**
+ * Hand lanes whose lookups have been abandoned to a detached thread to
+ * destroy. Tearing a lane down joins its resolver thread, which may be
+ * blocked in getaddrinfo for as long as the system resolver's own timeout,
+ * so doing it here would hold the call past its timeout.
+ */
+static void dns_lanes_abandon(std::vector < std::unique_ptr < dns_lane > >& lanes){
+  if(lanes.empty()){
+    return;
+  }
+  std::vector < std::unique_ptr < dns_lane > >* doomed =
+    new std::vector < std::unique_ptr < dns_lane > >(std::move(lanes));
+  lanes.clear();
+  std::thread([doomed](){ delete doomed; }).detach();
+}
+
+/**
+ * Abandons, when resolve_async returns or unwinds (on an interrupt, say),
+ * the lanes it retired on a timeout and any still mid-lookup.
+ */
+struct dns_lane_guard {
+  std::vector < std::unique_ptr < dns_lane > >& lanes;
+  std::vector < std::unique_ptr < dns_lane > >& retired;
+
+  dns_lane_guard(std::vector < std::unique_ptr < dns_lane > >& l,
+                 std::vector < std::unique_ptr < dns_lane > >& r) : lanes(l), retired(r) {}
+
+  ~dns_lane_guard(){
+    for(unsigned int l = 0; l < lanes.size(); l++){
+      if(lanes[l] && lanes[l]->query >= 0){
+        retired.push_back(std::move(lanes[l]));
+      }
+    }
+    dns_lanes_abandon(retired);
+  }
+};
+
+DataFrame asio_bindings::resolve_async(const CharacterVector& queries, bool reverse,
+                                       int concurrency, double timeout){
+
+  if(concurrency < 1){
+    throw std::range_error("concurrency must be at least 1");
+  }
+  if(!(timeout > 0)){
+    throw std::range_error("timeout must be a positive number of seconds");
+  }
+
+  R_xlen_t input_size = queries.size();
+  stats_call stats(reverse ? STATS_IP_TO_HOSTNAME_ASYNC : STATS_HOSTNAME_TO_IP_ASYNC, input_size);
+  std::vector < std::vector < std::string > > answers(input_size);
+  std::vector < int > status(input_size, DNS_OK);
+  std::vector < std::unique_ptr < dns_lane > > lanes;
+  std::vector < std::unique_ptr < dns_lane > > retired;
+  std::vector < std::unique_ptr < asio::steady_timer > > timers;
+  R_xlen_t next = 0, outstanding = 0;
+  std::chrono::milliseconds timeout_ms((long long) (timeout * 1000));
+  dns_cache& cache = dns_cache::instance();
+  double stub_delay = dns_stub_delay();
+  dns_lane_guard guard(lanes, retired);
+
+  for(int i = 0; i < concurrency && i < input_size; i++){
+    lanes.push_back(std::unique_ptr < dns_lane >(new dns_lane));
+    timers.push_back(std::unique_ptr < asio::steady_timer >(new asio::steady_timer(io_service)));
+  }
+
+  for(unsigned int polls = 0; next < input_size || outstanding > 0; polls++){
+
+    if((polls % 100) == 0){
       Rcpp::checkUserInterrupt();
     }
-    try{
-      //      output[i] = asio::ip::address_v6::from_string(ip_addresses[i]).to_string();
-      v = asio::ip::address_v6::from_string(ip_addresses[i]).to_bytes();
-      (void)snprintf(str, 50, "%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x:%02x%02x",
-       (uint8_t)v[0], (uint8_t)v[1], (uint8_t)v[2], (uint8_t)v[3], (uint8_t)v[4], (uint8_t)v[5], (uint8_t)v[6], (uint8_t)v[7], (uint8_t)v[8], (uint8_t)v[9], (uint8_t)v[10], (uint8_t)v[11], (uint8_t)v[12], (uint8_t)v[13], (uint8_t)v[14], (uint8_t)v[15]);
-      output[i] = std::string(str);
-    } catch (...) {
-      output[i] = "";
+
+    // poll() stops an io_service that has run out of work, so reset each
+    // one first
+    bool progress = false;
+    for(unsigned int l = 0; l < lanes.size(); l++){
+      lanes[l]->service.reset();
+      if(lanes[l]->service.poll() > 0){
+        progress = true;
+      }
+    }
+    io_service.reset();
+    if(io_service.poll() > 0){
+      progress = true;
+    }
+
+    for(unsigned int l = 0; l < lanes.size(); l++){
+      dns_lane* lane = lanes[l].get();
+
+      // collect a finished (or abandoned) lookup
+      if(lane->query >= 0 && (lane->done || lane->timed_out)){
+        if(lane->done){
+          answers[lane->query].swap(lane->answers);
+          status[lane->query] = lane->error ? DNS_NOT_RESOLVED : answers[lane->query].empty() ? DNS_NOT_RESOLVED : DNS_OK;
+          SEXP query_str = STRING_ELT(queries, lane->query);
+          std::string query(CHAR(query_str), LENGTH(query_str));
+          if(stub_delay < 0){
+            cache.store(reverse ? dns_cache::reverse_key(query) : dns_cache::forward_key(query),
+                        answers[lane->query], status[lane->query] != DNS_OK);
+          }
+          timers[l]->cancel();
+        } else {
+          // the system resolver can't be interrupted mid-lookup, so retire
+          // this lane (to be torn down in the background once the call
+          // ends) and carry on with a fresh one
+          status[lane->query] = DNS_TIMEOUT;
+          retired.push_back(std::move(lanes[l]));
+          lanes[l].reset(new dns_lane);
+          lane = lanes[l].get();
+        }
+        lane->query = -1;
+        outstanding--;
+        progress = true;
+      }
+
+      // hand the lane the next query
+      while(lane->query < 0 && next < input_size){
+        R_xlen_t q = next++;
+        SEXP query_str = STRING_ELT(queries, q);
+        std::string query(CHAR(query_str), LENGTH(query_str));
+        asio::error_code ec;
+        asio::ip::address ip;
+        if(reverse && query_str != NA_STRING){
+          ip = asio::ip::address::from_string(query, ec);
+        }
+        if(query_str == NA_STRING || ec){
+          status[q] = DNS_INVALID;
+          continue;
+        }
+
+        bool negative;
+        if(stub_delay < 0 &&
+           cache.lookup(reverse ? dns_cache::reverse_key(query) : dns_cache::forward_key(query),
+                        answers[q], negative)){
+          status[q] = negative ? DNS_NOT_RESOLVED : DNS_OK;
+          continue;
+        }
+
+        lane->query = q;
+        lane->done = false;
+        lane->timed_out = false;
+        lane->error = asio::error_code();
+        lane->answers.clear();
+        outstanding++;
+        progress = true;
+
+#ifdef IPTOOLS_DNS_STUB
+        if(stub_delay >= 0){
+          // the stub's thread sleeps in place of getaddrinfo, then posts its
+          // answer to the lane just as the resolver thread would
+          if(lane->stub.joinable()){
+            lane->stub.join();
+          }
+          lane->stub = std::thread([lane, q, reverse, stub_delay](){
+            std::this_thread::sleep_for(std::chrono::duration < double >(stub_delay));
+            lane->service.post([lane, q, reverse](){
+              if(lane->query != q) return;
+              lane->answers.push_back(reverse ? "stub.invalid" : "192.0.2.1");
+              lane->done = true;
+            });
+          });
+        } else
+#endif
+        if(reverse){
+          lane->resolver.async_resolve(asio::ip::tcp::endpoint(ip, 0),
+            [lane, q](const asio::error_code& error, asio::ip::tcp::resolver::iterator it){
+              if(lane->query != q) return;
+              lane->error = error;
+              for(asio::ip::tcp::resolver::iterator end; !error && it != end; ++it){
+                lane->answers.push_back(it->host_name());
+              }
+              lane->done = true;
+            });
+        } else {
+          lane->resolver.async_resolve(asio::ip::tcp::resolver::query(query, ""),
+            [lane, q](const asio::error_code& error, asio::ip::tcp::resolver::iterator it){
+              if(lane->query != q) return;
+              lane->error = error;
+              for(asio::ip::tcp::resolver::iterator end; !error && it != end; ++it){
+                lane->answers.push_back(it->endpoint().address().to_string());
+              }
+              lane->done = true;
+            });
+        }
+
+        timers[l]->expires_from_now(timeout_ms);
+        timers[l]->async_wait([lane, q](const asio::error_code& error){
+          if(error != asio::error::operation_aborted && lane->query == q && !lane->done){
+            lane->timed_out = true;
+          }
+        });
+      }
+    }
+
+    if(!progress){
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
   }
 
-  return output;
+  // let the cancelled timers' handlers run while their lanes still exist
+  for(unsigned int l = 0; l < timers.size(); l++){
+    timers[l]->cancel();
+  }
+  io_service.reset();
+  io_service.poll();
+
+  // one row per answer, or a single NA row for a query with none
+  R_xlen_t rows = 0;
+  for(R_xlen_t i = 0; i < input_size; i++){
+    rows += answers[i].empty() ? 1 : answers[i].size();
+  }
+
+  IntegerVector query_id(rows);
+  CharacterVector query(rows);
+  CharacterVector answer(rows);
+  CharacterVector status_str(rows);
+  const char* status_names[] = {"ok", "not_resolved", "timeout", "invalid"};
+
+  R_xlen_t row = 0, unresolved = 0;
+  for(R_xlen_t i = 0; i < input_size; i++){
+    unresolved += status[i] != DNS_OK;
+    size_t entries = answers[i].empty() ? 1 : answers[i].size();
+    for(size_t a = 0; a < entries; a++, row++){
+      query_id[row] = i + 1;
+      SET_STRING_ELT(query, row, STRING_ELT(queries, i));
+      SET_STRING_ELT(answer, row, answers[i].empty() ? NA_STRING :
+                     Rf_mkCharLenCE(answers[i][a].data(), answers[i][a].size(), CE_NATIVE));
+      status_str[row] = status_names[status[i]];
+    }
+  }
+
+  stats.invalid(unresolved);
+
+  return DataFrame::create(_["query_id"] = query_id,
+                           _["query"] = query,
+                           _["answer"] = answer,
+                           _["status"] = status_str,
+                           _["stringsAsFactors"] = false);
 }
 
-std::vector < unsigned long > asio_bindings::v6_scope_(std::vector < std::string > ip_addresses){
+DataFrame asio_bindings::async_hostname_to_dns(const CharacterVector& hostnames, int concurrency, double timeout){
+  return resolve_async(hostnames, false, concurrency, timeout);
+}
 
-  unsigned int input_size = ip_addresses.size();
-  std::vector < unsigned long > output(input_size);
+DataFrame asio_bindings::async_ip_to_dns(const CharacterVector& ip_addresses, int concurrency, double timeout){
+  return resolve_async(ip_addresses, true, concurrency, timeout);
+}
 
-  for(unsigned int i = 0; i < input_size; i++){
+SEXP asio_bindings::expand_ipv6_(const CharacterVector& ip_addresses) {
+
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
+  packed_ip_builder output(input_size, true, PACKED_EXPANDED, "");
+  stats_call stats(STATS_EXPAND_IPV6, input_size);
+  uint8_t bytes[16];
+  R_xlen_t invalid = 0;
+
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    try{
-      output[i] = asio::ip::address_v6::from_string(ip_addresses[i]).scope_id();
-    } catch (...) {
-      Rcout << "error" << std::endl;
-      output[i] = -1;
+    if (ips.v6(i, bytes)) {
+      output.set_v6(i, bytes);
+    } else {
+      output.set_invalid(i);
+      invalid++;
     }
   }
 
-  return output;
+  stats.invalid(invalid);
+  return output.finish();
 }
 
-std::vector < unsigned int > asio_bindings::ip_to_numeric_(std::vector < std::string > ip_addresses){
+NumericVector asio_bindings::v6_scope_(const CharacterVector& ip_addresses){
 
-  unsigned int input_size = ip_addresses.size();
-  std::vector < unsigned int > output(input_size);
+  R_xlen_t input_size = ip_addresses.size();
+  NumericVector output(input_size);
+  stats_call stats(STATS_V6_SCOPE, input_size);
+  uint8_t bytes[16];
+  size_t scope;
+  char *scope_end;
+  R_xlen_t invalid = 0;
 
-  for(unsigned int i = 0; i < input_size; i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    try{
-      output[i] = asio::ip::address_v4::from_string(ip_addresses[i]).to_ulong();
-    } catch (...) {
+    SEXP ip = STRING_ELT(ip_addresses, i);
+    size_t ip_len = LENGTH(ip);
+    if (parse_ipv6(CHAR(ip), ip_len, bytes, &scope) != IP_PARSE_OK) {
+      output[i] = (unsigned long) -1;
+      invalid++;
+    } else if (scope == ip_len) {
       output[i] = 0;
+    } else {
+      output[i] = strtoul(CHAR(ip) + scope + 1, &scope_end, 10);
+      if (*scope_end != '\0') {
+        // an interface name rather than a number; let asio look it up
+        try{
+          output[i] = asio::ip::address_v6::from_string(CHAR(ip)).scope_id();
+        } catch (...) {
+          stats_exception(STATS_V6_SCOPE);
+          output[i] = 0;
+        }
+      }
     }
   }
 
+  stats.invalid(invalid);
   return output;
 }
 
-std::vector < std::string > asio_bindings::numeric_to_ip_ (std::vector < unsigned int > ip_addresses){
-  unsigned int input_size = ip_addresses.size();
-  std::vector < std::string > output(input_size);
-
-  for(unsigned int i = 0; i < input_size; i++){
-    if((i % 10000) == 0){
-      Rcpp::checkUserInterrupt();
-    }
-    try{
-      output[i] = asio::ip::address_v4(ip_addresses[i]).to_string();
-    } catch (...) {
-      output[i] = "";
+NumericVector asio_bindings::ip_to_numeric_(const CharacterVector& ip_addresses){
+
+  R_xlen_t input_size = ip_addresses.size();
+  NumericVector output(input_size);
+  double *out = REAL(output);
+  address_reader ips(ip_addresses);
+  stats_call stats(STATS_IP_TO_NUMERIC, input_size);
+
+  parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+    R_xlen_t invalid = 0;
+    for(R_xlen_t i = begin; i < end; i++){
+      uint32_t ip = 0;
+      if (ips.v4(i, &ip)) {
+        out[i] = ip;
+      } else {
+        out[i] = 0;
+        invalid++;
+      }
     }
-  }
+    stats.invalid(invalid);
+  });
 
   return output;
 }
 
-CharacterVector asio_bindings::classify_ip_(CharacterVector ip_addresses){
-  unsigned int input_size = ip_addresses.size();
-  asio::ip::address holding;
-  CharacterVector output(input_size);
+SEXP asio_bindings::numeric_to_ip_ (const NumericVector& ip_addresses){
+  R_xlen_t input_size = ip_addresses.size();
+  packed_ip_builder output(input_size, false, PACKED_COMPRESSED, "");
+  const double *in = REAL(ip_addresses);
+  stats_call stats(STATS_NUMERIC_TO_IP, input_size);
+  R_xlen_t invalid = 0;
 
-  for(unsigned int i = 0; i < input_size; i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    if(ip_addresses[i] == NA_STRING){
-      output[i] = NA_STRING;
+    if (ISNAN(in[i])) {
+      output.set_na(i);
+      invalid++;
+    } else if (in[i] >= 0 && in[i] <= 4294967295.0) {
+      output.set_v4(i, (uint32_t) in[i]);
     } else {
-      try{
-        holding = asio::ip::address::from_string(ip_addresses[i]);
-        if(holding.is_v4()){
-          output[i] = "IPv4";
-        } else if(holding.is_v6()){
-          output[i] = "IPv6";
-        } else {
-          output[i] = NA_STRING;
-        }
-      } catch(...){
-        output[i] = NA_STRING;
-      }
+      output.set_v4(i, 0);
+      invalid++;
+    }
+  }
+
+  stats.invalid(invalid);
+  return output.finish();
+}
+
+CharacterVector asio_bindings::classify_ip_(const CharacterVector& ip_addresses){
+  R_xlen_t input_size = ip_addresses.size();
+  CharacterVector output(input_size);
+  std::vector < unsigned char > classes(input_size);
+  address_reader ips(ip_addresses);
+  stats_call stats(STATS_IP_CLASSIFY, input_size);
+
+  // classify off the main thread, then build the strings on it
+  parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+    uint32_t v4;
+    uint8_t v6[16];
+    R_xlen_t invalid = 0;
+    for(R_xlen_t i = begin; i < end; i++){
+      classes[i] = ips.family(i, &v4, v6);
+      invalid += classes[i] != PACKED_V4 && classes[i] != PACKED_V6;
     }
+    stats.invalid(invalid);
+  });
 
+  SEXP ipv4_str = PROTECT(Rf_mkChar("IPv4"));
+  SEXP ipv6_str = PROTECT(Rf_mkChar("IPv6"));
+  for(R_xlen_t i = 0; i < input_size; i++){
+    SET_STRING_ELT(output, i, classes[i] == PACKED_V4 ? ipv4_str : classes[i] == PACKED_V6 ? ipv6_str : NA_STRING);
   }
+
+  UNPROTECT(2);
   return output;
 }
 
-LogicalVector asio_bindings::is_multicast_ (CharacterVector ip_addresses){
+LogicalVector asio_bindings::is_multicast_ (const CharacterVector& ip_addresses){
 
-  unsigned int input_size = ip_addresses.size();
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
   LogicalVector output(input_size);
-  asio::ip::address holding;
+  int *out = LOGICAL(output);
+  stats_call stats(STATS_IS_MULTICAST, input_size);
+  uint32_t v4;
+  uint8_t v6[16];
+  R_xlen_t invalid = 0;
 
-  for(unsigned int i = 0; i < input_size; i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    if(ip_addresses[i] == NA_STRING){
-      output[i] = NA_LOGICAL;
-    } else {
-      try{
-        holding = asio::ip::address::from_string(ip_addresses[i]);
-        if(holding.is_multicast()){
-          output[i] = true;
-        } else {
-          output[i] = false;
-        }
-      } catch(...){
-        output[i] = NA_LOGICAL;
-      }
+    switch(ips.family(i, &v4, v6)){
+    case PACKED_V4:
+      // 224.0.0.0/4
+      out[i] = (v4 & 0xf0000000) == 0xe0000000;
+      break;
+    case PACKED_V6:
+      // ff00::/8
+      out[i] = v6[0] == 0xff;
+      break;
+    default:
+      out[i] = NA_LOGICAL;
+      invalid++;
     }
   }
+  stats.invalid(invalid);
   return output;
 }
 
-std::vector < bool > asio_bindings::ip_in_range_(std::vector < std::string > ip_addresses, std::vector < std::string > ranges){
+LogicalVector asio_bindings::ip_in_range_(const CharacterVector& ip_addresses, const CharacterVector& ranges){
 
   if(ip_addresses.size() != ranges.size() && ranges.size() != 1){
     throw std::range_error("You must provide either one range, or a vector of ranges the same size as the IP addresses");
   }
 
-  unsigned int input_size = ip_addresses.size();
-  std::vector < bool > output(input_size);
+  R_xlen_t input_size = ip_addresses.size();
+  LogicalVector output(input_size);
+  int *out = LOGICAL(output);
+  address_reader ips(ip_addresses);
+  stats_call stats(STATS_IP_IN_RANGE, input_size);
 
   if(ranges.size() == 1){
-    for(unsigned int i = 0; i < input_size; i++){
-      if((i % 10000) == 0){
-        Rcpp::checkUserInterrupt();
-      }
-      output[i] = single_ip_in_range(ip_addresses[i], ranges[0]);
+    // parse the range once, rather than once per IP
+    SEXP range = STRING_ELT(ranges, 0);
+    uint128 network, mask;
+    int family = range_mask(CHAR(range), LENGTH(range), network, mask);
+    if(family == 4){
+      uint32_t network4 = (uint32_t) network.lo, mask4 = (uint32_t) mask.lo;
+      parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+        uint32_t ip;
+        for(R_xlen_t i = begin; i < end; i++){
+          out[i] = ips.v4(i, &ip) && (ip & mask4) == network4;
+        }
+      });
+    } else if(family == 6){
+      parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+        uint8_t ip[16];
+        for(R_xlen_t i = begin; i < end; i++){
+          out[i] = ips.v6(i, ip) && (uint128::from_bytes(ip) & mask) == network;
+        }
+      });
+    } else {
+      stats.invalid(input_size);
     }
   } else {
-    for(unsigned int i = 0; i < input_size; i++){
-      if((i % 10000) == 0){
-        Rcpp::checkUserInterrupt();
+    string_refs rngs(ranges);
+    parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+      uint32_t v4;
+      uint8_t v6[16];
+      uint128 ip, network, mask;
+      R_xlen_t invalid = 0;
+      for(R_xlen_t i = begin; i < end; i++){
+        int family = ips.family(i, &v4, v6);
+        if(family == PACKED_V4){
+          ip = uint128(0, v4);
+        } else if(family == PACKED_V6){
+          ip = uint128::from_bytes(v6);
+        } else {
+          out[i] = false;
+          invalid++;
+          continue;
+        }
+        int range_family = range_mask(rngs.ptr[i], rngs.len[i], network, mask);
+        invalid += range_family == 0;
+        out[i] = range_family == family && (ip & mask) == network;
       }
-      output[i] = single_ip_in_range(ip_addresses[i], ranges[i]);
-    }
+      stats.invalid(invalid);
+    });
   }
 
   return output;
 }
 
-/* need this for the sort in ip_in_any() */
-bool rng_sort(const std::vector<unsigned int>&a,
-              const std::vector<unsigned int>&b) {
-  return(a[0] < b[0]);
-}
+void asio_bindings::build_range_index(const CharacterVector& ranges,
+                                      std::vector < std::pair < uint32_t, uint32_t > >& v4_index,
+                                      std::vector < std::pair < uint128, uint128 > >& v6_index){
 
-/* if someone has a compelling use-case, this shld be a trie */
-std::vector < bool > asio_bindings::ip_in_any_(std::vector < std::string > ip_addresses,
-                                               std::vector < std::string > ranges){
+  uint128 first_ip, last_ip;
+  stats_call stats(STATS_RANGE_INDEX, ranges.size());
+  R_xlen_t invalid = 0;
 
-  unsigned int input_size = ip_addresses.size();
-  unsigned int ranges_size = ranges.size();
-  std::vector < bool > output(input_size);
+  v4_index.clear();
+  v6_index.clear();
+  for (R_xlen_t i = 0; i < ranges.size(); i++) {
+    if((i % 10000) == 0){
+      Rcpp::checkUserInterrupt();
+    }
+    SEXP range = STRING_ELT(ranges, i);
+    switch (ip_range_bounds(CHAR(range), LENGTH(range), first_ip, last_ip)) {
+    case 4:
+      v4_index.push_back(std::make_pair((uint32_t) first_ip.lo, (uint32_t) last_ip.lo));
+      break;
+    case 6:
+      v6_index.push_back(std::make_pair(first_ip, last_ip));
+      break;
+    default:
+      invalid++;
+    }
+  }
+  stats.invalid(invalid);
+
+  /* sort the range bounds by the start value, then fold overlapping/adjacent ranges together */
+  cidr_merge(v4_index);
+  cidr_merge(v6_index);
+}
 
-  std::vector < std::vector < unsigned int> > range_bounds(ranges_size);
+LogicalVector asio_bindings::ip_in_any_(const CharacterVector& ip_addresses,
+                                        const CharacterVector& ranges){
 
-  /* convert range bounds, in-bulk, to integers */
-  for (unsigned int i=0; i<ranges_size; i++) {
-    range_bounds[i] = ip_to_numeric_(calculate_ip_range(ranges[i]));
+  R_xlen_t input_size = ip_addresses.size();
+  LogicalVector output(input_size);
+  int *out = LOGICAL(output);
+  std::vector < uint32_t > ips(input_size);
+  std::vector < unsigned char > families(input_size);
+  std::vector < uint128 > v6_ips;
+  bool sorted = true;
+  unsigned int previous = 0;
+  uint8_t v6[16];
+  stats_call stats(STATS_IP_IN_ANY, input_size);
+  R_xlen_t invalid = 0;
+
+  std::vector < std::pair < uint32_t, uint32_t > > index;
+  std::vector < std::pair < uint128, uint128 > > v6_index;
+  build_range_index(ranges, index, v6_index);
+
+  /* convert the input IPs to numeric, noting whether the IPv4 ones arrived in order;
+     IPv6 addresses are kept to one side, with ips[i] pointing at them */
+  address_reader reader(ip_addresses);
+  for(R_xlen_t i = 0; i < input_size; i++){
+    if((i % 10000) == 0){
+      Rcpp::checkUserInterrupt();
+    }
+    out[i] = false;
+    families[i] = reader.family(i, &ips[i], v6);
+    if (families[i] == PACKED_V6) {
+      ips[i] = v6_ips.size();
+      v6_ips.push_back(uint128::from_bytes(v6));
+      continue;
+    }
+    if (families[i] != PACKED_V4) {
+      invalid++;
+      continue;
+    }
+    if (ips[i] < previous) {
+      sorted = false;
+    }
+    previous = ips[i];
   }
 
-  /* sort the range bounds by the start value */
-  std::sort(range_bounds.begin(), range_bounds.end(), rng_sort);
+  std::vector < std::pair < uint32_t, uint32_t > >::const_iterator rng = index.begin();
 
-  for(unsigned int i = 0; i < input_size; i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    /* convert the input IP string to numeric */
-    unsigned int ipl = asio::ip::address_v4::from_string(ip_addresses[i]).to_ulong();
-    output[i] = false;
-    /* test if it's within a range. sequential search, but short-circuits the loop if true */
-    for (unsigned int j=0; j < ranges_size; j++) {
-      if((j % 10000) == 0){
-        Rcpp::checkUserInterrupt();
-      }
-      /* integer math so this _shld_ be faster than `if` tests */
-      if ((ipl - range_bounds[j][0]) <= (range_bounds[j][1] - range_bounds[j][0])) {
-        output[i] = true;
-        break;
+    if (families[i] == PACKED_V6) {
+      out[i] = cidr_index_contains(v6_index, v6_ips[ips[i]]);
+      continue;
+    }
+    if (families[i] != PACKED_V4 || index.empty()) {
+      continue;
+    }
+    if (sorted) {
+      /* ascending IPs: walk the index alongside the input rather than searching it */
+      while (rng != index.end() && rng->second < ips[i]) {
+        ++rng;
       }
+      out[i] = (rng != index.end() && rng->first <= ips[i]);
+    } else {
+      out[i] = cidr_index_contains(index, ips[i]);
     }
   }
+
+  stats.invalid(invalid);
   return output;
 }
 
-DataFrame asio_bindings::calculate_range_(std::vector < std::string > ranges){
-  int input_size = ranges.size();
-  std::vector < std::string > min_holding(input_size);
-  std::vector < std::string > max_holding(input_size);
-  std::vector < std::string > holding;
-
-  for(unsigned int i = 0; i < ranges.size(); i++){
+DataFrame asio_bindings::calculate_range_(const CharacterVector& ranges){
+  R_xlen_t input_size = ranges.size();
+  std::vector < unsigned char > families(input_size);
+  std::vector < uint128 > first(input_size), last(input_size);
+  NumericVector min_numeric(input_size);
+  NumericVector max_numeric(input_size);
+  bool any_v6 = false;
+  uint8_t bytes[16];
+  stats_call stats(STATS_RANGE_BOUNDARIES, input_size);
+  R_xlen_t invalid = 0;
+
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    holding = calculate_ip_range(ranges[i]);
-    min_holding[i] = holding[0];
-    max_holding[i] = holding[1];
-    holding.clear();
+    SEXP range = STRING_ELT(ranges, i);
+    families[i] = ip_range_bounds(CHAR(range), LENGTH(range), first[i], last[i]);
+    invalid += families[i] == 0;
+    if (families[i] == 4) {
+      min_numeric[i] = (double) first[i].lo;
+      max_numeric[i] = (double) last[i].lo;
+    } else if (families[i] == 6) {
+      // too big for a double to hold exactly
+      min_numeric[i] = NA_REAL;
+      max_numeric[i] = NA_REAL;
+      any_v6 = true;
+    }
+  }
+
+  packed_ip_builder min_holding(input_size, any_v6, PACKED_COMPRESSED, "Invalid");
+  packed_ip_builder max_holding(input_size, any_v6, PACKED_COMPRESSED, "Invalid");
+  for(R_xlen_t i = 0; i < input_size; i++){
+    if (families[i] == 4) {
+      min_holding.set_v4(i, (uint32_t) first[i].lo);
+      max_holding.set_v4(i, (uint32_t) last[i].lo);
+    } else if (families[i] == 6) {
+      first[i].to_bytes(bytes);
+      min_holding.set_v6(i, bytes);
+      last[i].to_bytes(bytes);
+      max_holding.set_v6(i, bytes);
+    } else {
+      min_holding.set_invalid(i);
+      max_holding.set_invalid(i);
+    }
   }
+  stats.invalid(invalid);
 
-  return DataFrame::create(_["minimum_ip"] = min_holding,
-                           _["maximum_ip"] = max_holding,
-                           _["min_numeric"] = ip_to_numeric_(min_holding),
-                           _["max_numeric"] = ip_to_numeric_(max_holding),
+  return DataFrame::create(_["minimum_ip"] = min_holding.finish(),
+                           _["maximum_ip"] = max_holding.finish(),
+                           _["min_numeric"] = min_numeric,
+                           _["max_numeric"] = max_numeric,
                            _["range"] = ranges,
                            _["stringsAsFactors"] = false);
 }
 
-std::vector < bool > asio_bindings::validate_range_(std::vector < std::string > ranges){
+LogicalVector asio_bindings::validate_range_(const CharacterVector& ranges){
 
-  unsigned int input_size = ranges.size();
-  std::vector < bool > output(input_size);
+  R_xlen_t input_size = ranges.size();
+  LogicalVector output(input_size);
+  int *out = LOGICAL(output);
+  stats_call stats(STATS_VALIDATE_RANGE, input_size);
+  R_xlen_t invalid = 0;
 
-  for(unsigned int i = 0; i < ranges.size(); i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if((i % 10000) == 0){
       Rcpp::checkUserInterrupt();
     }
-    output[i] = validate_single_range(ranges[i]);
+    SEXP range = STRING_ELT(ranges, i);
+    out[i] = validate_single_range(CHAR(range), LENGTH(range));
+    invalid += !out[i];
   }
+  stats.invalid(invalid);
   return output;
 }
 
-
-std::vector < std::string > asio_bindings::tokenise_xff(std::string x_forwarded_for){
-  std::vector < std::string > output;
-  std::string holding;
-  std::stringstream strm(x_forwarded_for);
-  while(strm.good()){
-    getline(strm, holding, ',');
-    output.push_back(holding);
+long asio_bindings::xff_untrusted_hop(const char* field, size_t len, size_t* hop_len,
+                                      const std::vector < std::pair < uint32_t, uint32_t > >& v4_index,
+                                      const std::vector < std::pair < uint128, uint128 > >& v6_index){
+  const char *token_end = field + len;
+  uint32_t v4;
+  uint8_t v6[16];
+  long found = -1;
+
+  // walk the hops from right to left, stopping at the first one that isn't a trusted proxy
+  for(;;){
+    const char *token = token_end;
+    while(token > field && token[-1] != ','){
+      token--;
+    }
+    const char *hop = token, *hop_end = token_end;
+    xff_trim(&hop, &hop_end);
+    if(parse_ipv4(hop, hop_end - hop, &v4) == IP_PARSE_OK){
+      found = hop - field;
+      *hop_len = hop_end - hop;
+      if(!cidr_index_contains(v4_index, v4)){
+        break;
+      }
+    } else if(parse_ipv6(hop, hop_end - hop, v6) == IP_PARSE_OK){
+      found = hop - field;
+      *hop_len = hop_end - hop;
+      if(!cidr_index_contains(v6_index, uint128::from_bytes(v6))){
+        break;
+      }
+    }
+    if(token == field){
+      break;
+    }
+    token_end = token - 1;
   }
-  return output;
+  return found;
 }
 
-std::vector < std::string > asio_bindings::xff_normalise(std::vector < std::string > ip_addresses,
-                                          std::vector < std::string > x_forwarded_for){
+CharacterVector asio_bindings::xff_normalise(const CharacterVector& ip_addresses,
+                                             const CharacterVector& x_forwarded_for,
+                                             const CharacterVector& trusted_proxies){
 
-  unsigned int input_size = ip_addresses.size();
+  R_xlen_t input_size = ip_addresses.size();
   if(input_size != x_forwarded_for.size()){
     throw std::range_error("the ip_addresses and x_forwarded_for vectors must be the same size");
   }
-
-  asio::ip::address ip_check;
-  std::vector < std::string > holding;
-  for(unsigned int i = 0; i < input_size; i++){
-    if((i % 10000) == 0){
-      Rcpp::checkUserInterrupt();
-    }
-    if(x_forwarded_for[i] != "-"){
-      holding = tokenise_xff(x_forwarded_for[i]);
-      for(unsigned int x = 0; x < holding.size(); x++){
-        try{
-          ip_check = asio::ip::address::from_string(holding[x]);
-          if(ip_check.is_v4() || ip_check.is_v6()){
-            ip_addresses[i] = holding[x];
-            break;
-          }
-        } catch(...){
-
+  stats_call stats(STATS_XFF_EXTRACT, input_size);
+
+  // where in each XFF field the chosen IP starts, and how long it is (-1 for
+  // "none; keep the input IP")
+  std::vector < int > hop_start(input_size);
+  std::vector < int > hop_length(input_size, -1);
+  string_refs xffs(x_forwarded_for);
+
+  if(trusted_proxies.size() == 0){
+    parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+      for(R_xlen_t i = begin; i < end; i++){
+        size_t len;
+        long start = xff_first_hop(xffs.ptr[i], xffs.len[i], &len);
+        if(start >= 0){
+          hop_start[i] = start;
+          hop_length[i] = len;
+        }
+      }
+    });
+  } else {
+    std::vector < std::pair < uint32_t, uint32_t > > v4_index;
+    std::vector < std::pair < uint128, uint128 > > v6_index;
+    build_range_index(trusted_proxies, v4_index, v6_index);
+    address_reader remotes(ip_addresses);
+
+    parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+      uint32_t v4;
+      uint8_t v6[16];
+      for(R_xlen_t i = begin; i < end; i++){
+        // the XFF header only counts if the request came from a trusted proxy
+        int family = remotes.family(i, &v4, v6);
+        bool trusted = (family == PACKED_V4 && cidr_index_contains(v4_index, v4)) ||
+          (family == PACKED_V6 && cidr_index_contains(v6_index, uint128::from_bytes(v6)));
+        if(!trusted){
+          continue;
+        }
+        size_t len;
+        long start = xff_untrusted_hop(xffs.ptr[i], xffs.len[i], &len, v4_index, v6_index);
+        if(start >= 0){
+          hop_start[i] = start;
+          hop_length[i] = len;
         }
       }
+    });
+  }
+
+  // unchanged entries keep the input's CHARSXPs rather than being copied
+  CharacterVector output(input_size);
+  for(R_xlen_t i = 0; i < input_size; i++){
+    if(hop_length[i] < 0){
+      SET_STRING_ELT(output, i, STRING_ELT(ip_addresses, i));
+    } else {
+      SET_STRING_ELT(output, i, Rf_mkCharLenCE(xffs.ptr[i] + hop_start[i], hop_length[i], CE_NATIVE));
     }
   }
 
-  return ip_addresses;
+  return output;
 }
@@ -13,8 +13,11 @@
 // #endif
 
 #include <iostream>
+#include <memory>
 #include <sstream>
 
+#include "cidr.h"
+
 using namespace Rcpp;
 
 #ifndef __ASIO_BINDINGS__
@@ -68,33 +71,57 @@ private:
   std::vector < std::string > single_ip_to_dns(std::string ip_address, asio::ip::tcp::resolver& resolver_ptr);
 
   /**
-   * A function for identifying whether or not an IP
-   * address falls within a CIDR range.
+   * A function for turning an IPv4 or IPv6 CIDR range into a network
+   * address and netmask, so that membership is a single AND.
    *
-   * @param ip_address an IP address.
+   * @param range an IP range.
    *
-   * @param range the range.
+   * @param range_len the length of range.
    *
-   * @see ip_in_range_ for the vectorised version
+   * @param network where the network address is written.
    *
-   * @return a boolean true (in range) or false (not
-   * in range)
+   * @param mask where the netmask is written.
+   *
+   * @return the range's address family (4 or 6), or 0 if it wasn't valid.
    */
-  bool single_ip_in_range(std::string ip_address, std::string range);
+  int range_mask(const char* range, size_t range_len, uint128& network, uint128& mask);
 
   /**
-   * A function for identifying the minimum and maximum values
-   * of a given IP range
+   * A function for identifying the numeric minimum and maximum
+   * of a given IPv4 or IPv6 range
    *
    * @param range an IP range.
    *
-   * @see calculate_range_ for the vectorised version
+   * @param range_len the length of range.
+   *
+   * @param first_ip where the minimum IP is written.
+   *
+   * @param last_ip where the maximum IP is written.
+   *
+   * @see calculate_range_, which formats the result
+   *
+   * @return the range's address family (4 or 6), or 0 if it wasn't valid.
+   */
+  int ip_range_bounds(const char* range, size_t range_len, uint128& first_ip, uint128& last_ip);
+
+  /**
+   * A function for building lookup indices from a set of IPv4 and IPv6 ranges.
+   * Ranges are sorted by their minimum IP, and overlapping or adjacent
+   * ranges are merged, so the index is a sorted vector of disjoint
+   * intervals that can be binary-searched.
+   *
+   * @param ranges a vector of CIDR ranges. Invalid ranges are dropped.
    *
-   * @return a string vector of length 2 containing the
-   * maxima and minima for that IP range, or c("Invalid",
-   * "Invalid") if the range is, well, invalid.
+   * @param v4_index where the IPv4 (minimum, maximum) pairs are written,
+   * sorted by minimum.
+   *
+   * @param v6_index the same, for IPv6 ranges.
+   *
+   * @see ip_in_any_ which uses this
    */
-  std::vector < std::string > calculate_ip_range(std::string range);
+  void build_range_index(const CharacterVector& ranges,
+                         std::vector < std::pair < uint32_t, uint32_t > >& v4_index,
+                         std::vector < std::pair < uint128, uint128 > >& v6_index);
 
   /**
    * A function for identifying whether a given string is
@@ -102,25 +129,65 @@ private:
    *
    * @param range an IP range.
    *
+   * @param range_len the length of range.
+   *
    * @see validate_range_ for the vectorised version
    *
    * @return a boolean true or false, where true is
    * "this is a CIDR range" and false is "this isn't,
    * or isn't a valid IP at all"
    */
-  bool validate_single_range(std::string range);
+  bool validate_single_range(const char* range, size_t range_len);
 
   /**
-   * A function for tokenising XFF fields
+   * A function for finding the client address in an X-Forwarded-For field
+   * written by a chain of trusted proxies: the right-most valid hop that isn't
+   * a trusted proxy, or the left-most valid hop if they all are. Whitespace
+   * around hops is ignored, and invalid hops skipped.
+   *
+   * @param field the field.
+   *
+   * @param len the length of field.
+   *
+   * @param hop_len where the address's length is written.
    *
-   * @param x_forwarded_for an x_forwarded_for field
+   * @param v4_index the trusted IPv4 ranges, from build_range_index.
+   *
+   * @param v6_index the trusted IPv6 ranges, from build_range_index.
    *
    * @see xff_normalise which uses this
    *
-   * @return a vector containing the chain of IP addresses
-   * split out from the XFF field.
+   * @return the address's offset in field, or -1 if there isn't one.
+   */
+  long xff_untrusted_hop(const char* field, size_t len, size_t* hop_len,
+                         const std::vector < std::pair < uint32_t, uint32_t > >& v4_index,
+                         const std::vector < std::pair < uint128, uint128 > >& v6_index);
+
+  /**
+   * The outcome of a single lookup made by resolve_async.
+   */
+  enum dns_status {DNS_OK = 0, DNS_NOT_RESOLVED, DNS_TIMEOUT, DNS_INVALID};
+
+  /**
+   * A function for resolving many hostnames or IP addresses at once, with
+   * a bounded number of lookups in flight.
+   *
+   * @param queries the hostnames or IP addresses.
+   *
+   * @param reverse true for IP-to-hostname lookups, false for hostname-to-IP.
+   *
+   * @param concurrency the maximum number of lookups in flight at once.
+   *
+   * @param timeout how long (in seconds) to wait for any one lookup.
+   *
+   * @see async_hostname_to_dns and async_ip_to_dns, which use this.
+   *
+   * @return a data.frame with one row per answer (or one NA row for a query
+   * without any), containing the 1-based index of the query, the query, the
+   * answer and a status of "ok", "not_resolved", "timeout" or "invalid".
    */
-  std::vector < std::string > tokenise_xff(std::string x_forwarded_for);
+  DataFrame resolve_async(const CharacterVector& queries, bool reverse,
+                          int concurrency, double timeout);
 
 public:
 
@@ -158,9 +225,35 @@ public:
       std::vector < std::string > ip_addresses
   );
 
-  std::vector < unsigned long > v6_scope_(std::vector < std::string > ip_addresses);
+  /**
+   * An asynchronous version of multi_hostname_to_dns.
+   *
+   * @param hostnames a vector of hostnames.
+   *
+   * @param concurrency the maximum number of lookups in flight at once.
+   *
+   * @param timeout how long (in seconds) to wait for any one lookup.
+   *
+   * @see resolve_async for the return format.
+   */
+  DataFrame async_hostname_to_dns(const CharacterVector& hostnames, int concurrency, double timeout);
+
+  /**
+   * An asynchronous version of multi_ip_to_dns.
+   *
+   * @param ip_addresses a vector of IPv4 or IPv6 addresses.
+   *
+   * @param concurrency the maximum number of lookups in flight at once.
+   *
+   * @param timeout how long (in seconds) to wait for any one lookup.
+   *
+   * @see resolve_async for the return format.
+   */
+  DataFrame async_ip_to_dns(const CharacterVector& ip_addresses, int concurrency, double timeout);
+
+  NumericVector v6_scope_(const CharacterVector& ip_addresses);
 
-  std::vector < std::string > expand_ipv6_(std::vector < std::string > ip_addresses);
+  SEXP expand_ipv6_(const CharacterVector& ip_addresses);
 
   /**
    * A function for taking a vector of IPv4 addresses in dotted-decimal
@@ -172,25 +265,24 @@ public:
    *
    * @see ip_to_numeric_ for the opposite functionality.
    *
-   * @return a vector of unsigned integers containing the numeric
-   * representation of each input IP. Non-IPv4 IPs are represented
-   * with -1
+   * @return a vector containing the numeric representation of each
+   * input IP. Non-IPv4 IPs are represented with 0
    */
-  std::vector < unsigned int > ip_to_numeric_(std::vector < std::string > ip_addresses);
+  NumericVector ip_to_numeric_(const CharacterVector& ip_addresses);
 
   /**
    * A function for taking a vector of IPv4 addresses in numeric form
    * and converting them to their dotted-decimal notation.
    *
-   * @param a vector of unsigned integers representing the IP addresses.
+   * @param a vector of numbers representing the IP addresses.
    *
    * @see numeric_to_ip_ for the opposite functionality.
    *
-   * @return a vector of strings containing the dotted-decimal
-   * representation of each input IP. Non-IPv4 IPs are represented
-   * with an empty string
+   * @return a packed address vector (see packed_ip.h) of the
+   * dotted-decimal representation of each input IP. NAs stay NA, and
+   * values outside the IPv4 space are represented with "0.0.0.0"
    */
-  std::vector < std::string > numeric_to_ip_ (std::vector < unsigned int > ip_addresses);
+  SEXP numeric_to_ip_ (const NumericVector& ip_addresses);
 
   /**
    * Classify IP addresses as either IPv4, IPv6 or invalid.
@@ -201,7 +293,7 @@ public:
    * @return a vector of strings containing "IPv4", "IPv6"
    * or "Invalid" for each element of the input vector.
    */
-  CharacterVector classify_ip_ (CharacterVector ip_addresses);
+  CharacterVector classify_ip_ (const CharacterVector& ip_addresses);
 
   /**
    * Identify if IP addresses are multicast or not
@@ -212,7 +304,7 @@ public:
    * @return a boolean vector containing trues for those that
    * are multicast, and false for those that aren't.
    */
-  LogicalVector is_multicast_ (CharacterVector ip_addresses);
+  LogicalVector is_multicast_ (const CharacterVector& ip_addresses);
 
   /**
    * A function for identifying whether or vector of
@@ -222,13 +314,12 @@ public:
    *
    * @param range a vector of ranges.
    *
-   * @see single_ip_in_range for the non-vectorised
-   * version.
+   * @see range_mask, which parses each range.
    *
    * @return a vector of boolean true (in range) or false (not
    * in range) for each IP.
    */
-  std::vector < bool > ip_in_range_(std::vector < std::string > ip_addresses, std::vector < std::string > ranges);
+  LogicalVector ip_in_range_(const CharacterVector& ip_addresses, const CharacterVector& ranges);
 
   /**
    * A function for identifying whether or vector of
@@ -242,21 +333,23 @@ public:
    * in ranges) for each IP.
    */
 
-  std::vector < bool > ip_in_any_(std::vector < std::string > ip_addresses, std::vector < std::string > ranges);
+  LogicalVector ip_in_any_(const CharacterVector& ip_addresses, const CharacterVector& ranges);
 
   /**
-   * A vectorised version of calculate_ip_range
+   * A vectorised function for identifying the minimum and maximum
+   * values of IPv4 and IPv6 ranges
    *
    * @param ranges a vector of CIDR ranges
    *
-   * @see calculate_ip_range for the non-vectorised
+   * @see ip_range_bounds for the non-vectorised
    * version.
    *
-   * @return a list of vectors, each vector containing
-   * the minimum and maximum IPs in a given range, in
-   * dotted-decimal notation.
+   * @return a data.frame containing the minimum and maximum IPs
+   * in each range, as packed address vectors and in numeric form.
+   * Invalid ranges are represented with "Invalid" and 0; IPv6 ranges
+   * have NA numeric bounds.
    */
-  DataFrame calculate_range_(std::vector < std::string > ranges);
+  DataFrame calculate_range_(const CharacterVector& ranges);
 
   /**
    * A vectorised version of validate_single_range
@@ -269,22 +362,28 @@ public:
    * "this is a CIDR range" and false is "this isn't,
    * or isn't a valid IP at all"
    */
-  std::vector < bool > validate_range_(std::vector < std::string > ranges);
+  LogicalVector validate_range_(const CharacterVector& ranges);
 
   /**
    * A normaliser for the x_forwarded_for HTTP field. Takes a vector of IPs and the
-   * corresponding XFF headers and grabs the earliest valid XFF.
+   * corresponding XFF headers and grabs the earliest valid XFF or, given a set of
+   * trusted proxies, the right-most hop that isn't one of them.
    *
    * @param ip_addresses a vector of IP addresses.
    *
    * @param x_forwarded_for a vector of x_forwarded_for fields
    *
+   * @param trusted_proxies a vector of CIDR ranges; may be empty.
+   *
+   * @see xff_untrusted_hop, which scans a field when there are trusted proxies.
+   *
    * @return a vector of normalised XFF fields - specifically, the earliest valid
-   * IP address in the chain.
+   * IP address in the chain, or the client address as seen by the trusted proxies.
    *
    */
-  std::vector < std::string > xff_normalise(std::vector < std::string > ip_addresses,
-                                            std::vector < std::string > x_forwarded_for);
+  CharacterVector xff_normalise(const CharacterVector& ip_addresses,
+                                const CharacterVector& x_forwarded_for,
+                                const CharacterVector& trusted_proxies);
 };
 
 #endif
\ No newline at end of file
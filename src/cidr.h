@@ -0,0 +1,272 @@
+#ifndef __IPTOOLS_CIDR__
+#define __IPTOOLS_CIDR__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "ip_parse.h"
+
+/**
+ * An unsigned 128-bit integer held as two 64-bit words, used for IPv6
+ * addresses and (with the high word zero) IPv4 addresses, so that CIDR
+ * arithmetic can be written once for both families.
+ */
+struct uint128 {
+  uint64_t hi;
+  uint64_t lo;
+
+  uint128() : hi(0), lo(0) {}
+  uint128(uint64_t h, uint64_t l) : hi(h), lo(l) {}
+
+  static uint128 from_bytes(const uint8_t *b) {
+    uint128 out;
+    for (int i = 0; i < 8; i++) {
+      out.hi = (out.hi << 8) | b[i];
+      out.lo = (out.lo << 8) | b[i + 8];
+    }
+    return out;
+  }
+
+  void to_bytes(uint8_t *b) const {
+    for (int i = 7; i >= 0; i--) {
+      b[i] = (uint8_t) (hi >> (8 * (7 - i)));
+      b[i + 8] = (uint8_t) (lo >> (8 * (7 - i)));
+    }
+  }
+
+  bool operator==(const uint128& o) const { return hi == o.hi && lo == o.lo; }
+  bool operator!=(const uint128& o) const { return !(*this == o); }
+  bool operator<(const uint128& o) const { return hi < o.hi || (hi == o.hi && lo < o.lo); }
+  bool operator<=(const uint128& o) const { return !(o < *this); }
+  bool operator>(const uint128& o) const { return o < *this; }
+  bool operator>=(const uint128& o) const { return !(*this < o); }
+
+  uint128 operator&(const uint128& o) const { return uint128(hi & o.hi, lo & o.lo); }
+  uint128 operator|(const uint128& o) const { return uint128(hi | o.hi, lo | o.lo); }
+  uint128 operator~() const { return uint128(~hi, ~lo); }
+
+  uint128 operator+(uint64_t n) const { return uint128(hi + (lo + n < lo), lo + n); }
+  uint128 operator-(const uint128& o) const { return uint128(hi - o.hi - (lo < o.lo), lo - o.lo); }
+
+  uint128 plus_one() const { return uint128(lo == UINT64_MAX ? hi + 1 : hi, lo + 1); }
+  uint128 minus_one() const { return uint128(lo == 0 ? hi - 1 : hi, lo - 1); }
+};
+
+/**
+ * The number of bits in an address of the given family (4 or 6).
+ */
+static inline int cidr_bits(int family) {
+  return family == 6 ? 128 : 32;
+}
+
+/**
+ * The largest address of the given family.
+ */
+static inline uint128 cidr_max(int family) {
+  return family == 6 ? uint128(UINT64_MAX, UINT64_MAX) : uint128(0, 0xffffffffULL);
+}
+
+/**
+ * The host part of a prefix: every bit after the first prefix bits of an
+ * address of the given family. prefix is clamped to [0, bits].
+ */
+static inline uint128 cidr_host_mask(int family, int prefix) {
+  int bits = cidr_bits(family);
+  int host = prefix <= 0 ? bits : prefix >= bits ? 0 : bits - prefix;
+  if (host == 0) return uint128();
+  if (host >= 128) return uint128(UINT64_MAX, UINT64_MAX);
+  if (host >= 64) return uint128(host == 64 ? 0 : (UINT64_MAX >> (128 - host)), UINT64_MAX);
+  return uint128(0, UINT64_MAX >> (64 - host));
+}
+
+/**
+ * The network part of a prefix; see cidr_host_mask.
+ */
+static inline uint128 cidr_net_mask(int family, int prefix) {
+  return ~cidr_host_mask(family, prefix) & cidr_max(family);
+}
+
+/**
+ * Parse an IPv4 or IPv6 address into a uint128.
+ *
+ * @return the address family (4 or 6), or 0 if it isn't an address.
+ */
+static inline int cidr_parse_address(const char *str, size_t len, uint128 *out) {
+  uint32_t v4;
+  uint8_t v6[16];
+  if (parse_ipv4(str, len, &v4) == IP_PARSE_OK) {
+    *out = uint128(0, v4);
+    return 4;
+  }
+  if (parse_ipv6(str, len, v6) == IP_PARSE_OK) {
+    *out = uint128::from_bytes(v6);
+    return 6;
+  }
+  return 0;
+}
+
+/**
+ * Split a CIDR range ("10.0.0.0/8", "2001:db8::/32") into its address and
+ * prefix length. As with the original IPv4-only code, the prefix is read
+ * the way atoi reads it, so it is only checked for sign, not for stray characters.
+ *
+ * @param prefix where the prefix length is written (unclamped).
+ *
+ * @return the address family (4 or 6), or 0 if there's no slash or the
+ * address is invalid.
+ */
+static inline int cidr_parse(const char *str, size_t len, uint128 *address, int *prefix) {
+  const char *slash = (const char*) memchr(str, '/', len);
+  if (slash == NULL) {
+    return 0;
+  }
+  int family = cidr_parse_address(str, slash - str, address);
+  if (family) {
+    // atoi, but bounded by len
+    const char *p = slash + 1, *end = str + len;
+    bool negative = false;
+    long value = 0;
+    while (p < end && (*p == ' ' || (*p >= '\t' && *p <= '\r'))) p++;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    while (p < end && *p >= '0' && *p <= '9' && value < 100000) value = value * 10 + (*p++ - '0');
+    *prefix = (int) (negative ? -value : value);
+  }
+  return family;
+}
+
+/**
+ * Whether an interval starting at start can be folded into one ending at
+ * end (because they overlap or are adjacent).
+ */
+static inline bool cidr_adjacent(uint32_t end, uint32_t start) {
+  return end == 0xffffffff || start <= end + 1;
+}
+
+static inline bool cidr_adjacent(const uint128& end, const uint128& start) {
+  return (end.hi == UINT64_MAX && end.lo == UINT64_MAX) || start <= end.plus_one();
+}
+
+/**
+ * Sort a set of closed intervals by their start and fold overlapping or
+ * adjacent ones together, leaving a sorted vector of disjoint intervals
+ * that can be binary-searched.
+ */
+template < typename T >
+void cidr_merge(std::vector < std::pair < T, T > >& intervals) {
+  std::sort(intervals.begin(), intervals.end());
+  size_t out = 0;
+  for (size_t i = 0; i < intervals.size(); i++) {
+    if (out > 0 && cidr_adjacent(intervals[out - 1].second, intervals[i].first)) {
+      if (intervals[i].second > intervals[out - 1].second) {
+        intervals[out - 1].second = intervals[i].second;
+      }
+    } else {
+      intervals[out++] = intervals[i];
+    }
+  }
+  intervals.resize(out);
+}
+
+/**
+ * Whether a value falls in one of a set of intervals merged by cidr_merge.
+ */
+template < typename T >
+bool cidr_index_contains(const std::vector < std::pair < T, T > >& index, const T& value) {
+  // the last interval starting at or before the value is the only candidate
+  typename std::vector < std::pair < T, T > >::const_iterator hit =
+    std::upper_bound(index.begin(), index.end(), value,
+                     [](const T& v, const std::pair < T, T >& interval){ return v < interval.first; });
+  return hit != index.begin() && (--hit)->second >= value;
+}
+
+/**
+ * The intersection of two sets of intervals merged by cidr_merge, as a
+ * third such set, in one pass over both.
+ */
+static inline void cidr_intersect_intervals(const std::vector < std::pair < uint128, uint128 > >& a,
+                                            const std::vector < std::pair < uint128, uint128 > >& b,
+                                            std::vector < std::pair < uint128, uint128 > >& out) {
+  out.clear();
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    const uint128& first = a[i].first > b[j].first ? a[i].first : b[j].first;
+    const uint128& last = a[i].second < b[j].second ? a[i].second : b[j].second;
+    if (first <= last) {
+      out.push_back(std::make_pair(first, last));
+    }
+    // whichever interval ends first can't overlap anything further on
+    if (a[i].second < b[j].second) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+}
+
+/**
+ * The intervals of a not covered by b (both merged by cidr_merge), as a
+ * third such set, in one pass over both.
+ */
+static inline void cidr_subtract_intervals(const std::vector < std::pair < uint128, uint128 > >& a,
+                                           const std::vector < std::pair < uint128, uint128 > >& b,
+                                           std::vector < std::pair < uint128, uint128 > >& out) {
+  out.clear();
+  size_t j = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    uint128 first = a[i].first;
+    const uint128& last = a[i].second;
+    bool remaining = true;
+    // skip the holes that end before this interval starts
+    while (j < b.size() && b[j].second < first) {
+      j++;
+    }
+    for (size_t k = j; remaining && k < b.size() && b[k].first <= last; k++) {
+      if (b[k].first > first) {
+        out.push_back(std::make_pair(first, b[k].first.minus_one()));
+      }
+      if (b[k].second >= last) {
+        remaining = false;
+      } else {
+        first = b[k].second.plus_one();
+      }
+    }
+    if (remaining) {
+      out.push_back(std::make_pair(first, last));
+    }
+  }
+}
+
+/**
+ * Split the closed interval [first, last] of addresses of the given family
+ * into the smallest set of CIDR blocks that covers it exactly, in
+ * ascending order. Each block is grown one bit at a time for as long as
+ * its network address stays aligned and it stays inside the interval.
+ *
+ * @param emit called with each block's network address and prefix length.
+ */
+template < typename F >
+void cidr_decompose(uint128 first, const uint128& last, int family, F emit) {
+  int bits = cidr_bits(family);
+  for (;;) {
+    int host = 0;
+    while (host < bits) {
+      uint128 wider = cidr_host_mask(family, bits - host - 1);
+      if ((first & wider) != uint128() || (first | wider) > last) {
+        break;
+      }
+      host++;
+    }
+    emit(first, bits - host);
+    uint128 end = first | cidr_host_mask(family, bits - host);
+    if (end >= last) {
+      return;
+    }
+    first = end.plus_one();
+  }
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <Rcpp.h>
+
+#include "cidr.h"
+#include "interval_table.h"
+#include "packed_ip.h"
+#include "parallel.h"
+
+using namespace Rcpp;
+
+/**
+ * The compiled form of a named list of per-country CIDR blocks; this is
+ * what lives behind the external pointer handed to R.
+ */
+struct country_table {
+  interval_table v4;
+  interval_table v6;
+  std::vector < std::string > countries;
+};
+
+static country_table* get_country_table(SEXP tbl){
+  if (TYPEOF(tbl) != EXTPTRSXP || !Rf_inherits(tbl, "iptools_country_table")) {
+    throw std::range_error("Not a compiled country table");
+  }
+  country_table* ptr = (country_table*) R_ExternalPtrAddr(tbl);
+  if (ptr == NULL) {
+    throw std::range_error("The country table is no longer valid (was it saved and reloaded?)");
+  }
+  return ptr;
+}
+
+// [[Rcpp::export]]
+SEXP country_table_build(List ranges) {
+
+  SEXP names = Rf_getAttrib(ranges, R_NamesSymbol);
+  if (Rf_isNull(names)) {
+    throw std::range_error("ranges must be a named list");
+  }
+  CharacterVector countries(names);
+
+  XPtr < country_table > out(new country_table, true);
+  std::vector < interval_table::entry > v4_entries, v6_entries;
+  uint128 address;
+  int prefix;
+
+  for (R_xlen_t i = 0; i < ranges.size(); i++) {
+    Rcpp::checkUserInterrupt();
+    out->countries.push_back(countries[i] == NA_STRING ? std::string("NA") : std::string(countries[i]));
+    if (TYPEOF(VECTOR_ELT(ranges, i)) != STRSXP) {
+      continue;
+    }
+    CharacterVector cidrs(VECTOR_ELT(ranges, i));
+    for (R_xlen_t j = 0; j < cidrs.size(); j++) {
+      SEXP cidr = STRING_ELT(cidrs, j);
+      if (cidr == NA_STRING) {
+        continue;
+      }
+      int family = cidr_parse(CHAR(cidr), LENGTH(cidr), &address, &prefix);
+      if (!family) {
+        // a bare address is a block of one
+        family = cidr_parse_address(CHAR(cidr), LENGTH(cidr), &address);
+        prefix = cidr_bits(family);
+      }
+      if (!family || prefix < 0 || prefix > cidr_bits(family)) {
+        continue;
+      }
+      uint128 network = address & cidr_net_mask(family, prefix);
+      interval_table::entry block(network, network | cidr_host_mask(family, prefix), (int) i);
+      (family == 4 ? v4_entries : v6_entries).push_back(block);
+    }
+  }
+
+  out->v4.build(v4_entries);
+  out->v6.build(v6_entries);
+  out.attr("class") = "iptools_country_table";
+
+  return out;
+}
+
+// [[Rcpp::export]]
+IntegerVector country_table_lookup(SEXP tbl, SEXP ip_addresses) {
+
+  const country_table* ptr = get_country_table(tbl);
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
+  IntegerVector output(input_size);
+  int *out = INTEGER(output);
+
+  parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+    uint32_t v4;
+    uint8_t v6[16];
+    for (R_xlen_t i = begin; i < end; i++) {
+      int hit = interval_table::no_match;
+      switch (ips.family(i, &v4, v6)) {
+      case PACKED_V4:
+        hit = ptr->v4.lookup(uint128(0, v4));
+        break;
+      case PACKED_V6:
+        hit = ptr->v6.lookup(uint128::from_bytes(v6));
+        break;
+      }
+      out[i] = hit == interval_table::no_match ? NA_INTEGER : hit + 1;
+    }
+  });
+
+  output.attr("levels") = CharacterVector(ptr->countries.begin(), ptr->countries.end());
+  output.attr("class") = "factor";
+  return output;
+}
+
+// [[Rcpp::export]]
+NumericVector country_table_size(SEXP tbl) {
+  const country_table* ptr = get_country_table(tbl);
+  return NumericVector::create((double) (ptr->v4.size() + ptr->v6.size()), (double) ptr->countries.size());
+}
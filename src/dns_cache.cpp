@@ -0,0 +1,74 @@
+#include <Rcpp.h>
+#include <algorithm>
+#include <limits>
+
+#include "dns_cache.h"
+
+using namespace Rcpp;
+
+//' @title Configure, inspect and clear the DNS cache
+//' @description \code{\link{hostname_to_ip}}, \code{\link{ip_to_hostname}} and their
+//' \code{_async} versions share an in-memory cache of DNS answers, so repeated
+//' queries don't go back to the resolver. Failed lookups are cached too (for
+//' \code{negative_ttl} seconds), so repeated misses are cheap; timeouts are not.
+//' When the cache is full the least recently used entry is dropped.
+//'
+//' \code{dns_cache_config} changes the cache's size and lifetimes,
+//' \code{dns_cache_stats} reports on it, and \code{dns_cache_flush} empties it.
+//'
+//' @param max_entries the maximum number of queries to remember. 0 turns the
+//' cache off and \code{Inf} leaves it unbounded.
+//'
+//' @param positive_ttl how long, in seconds, to remember a successful lookup.
+//' TTLs longer than a century (\code{Inf}, say) are cut down to one.
+//'
+//' @param negative_ttl how long, in seconds, to remember a failed lookup. 0 turns
+//' negative caching off.
+//'
+//' @return \code{dns_cache_stats} returns a one-row data.frame containing the
+//' number of cached queries (\code{entries}), the configuration, and the number
+//' of \code{hits}, \code{misses} and \code{evictions} since the cache was last
+//' flushed. \code{dns_cache_config} returns the same, invisibly, with the new
+//' configuration; \code{dns_cache_flush} returns nothing.
+//'
+//' @examples
+//' dns_cache_config(max_entries = 50000, positive_ttl = 3600)
+//' dns_cache_stats()
+//' dns_cache_flush()
+//'
+//' @rdname dns_cache
+//' @export
+// [[Rcpp::export]]
+DataFrame dns_cache_stats(){
+  dns_cache::stats stats = dns_cache::instance().get_stats();
+  return DataFrame::create(_["entries"] = (double) stats.entries,
+                           _["max_entries"] = (double) stats.max_entries,
+                           _["positive_ttl"] = stats.positive_ttl,
+                           _["negative_ttl"] = stats.negative_ttl,
+                           _["hits"] = (double) stats.hits,
+                           _["misses"] = (double) stats.misses,
+                           _["evictions"] = (double) stats.evictions);
+}
+
+//' @rdname dns_cache
+//' @export
+// [[Rcpp::export]]
+void dns_cache_flush(){
+  dns_cache::instance().flush();
+}
+
+// [[Rcpp::export]]
+DataFrame int_dns_cache_config(double max_entries, double positive_ttl, double negative_ttl){
+  if (ISNAN(max_entries) || max_entries < 0 || ISNAN(positive_ttl) || ISNAN(negative_ttl)) {
+    throw std::range_error("max_entries and the TTLs must be non-negative numbers");
+  }
+  // Inf (or anything huge) means "forever"; clamp so the casts to size_t and
+  // to the clock's duration can't overflow. A century is forever enough.
+  const double max_ttl = 100 * 365.25 * 24 * 60 * 60;
+  positive_ttl = std::min(positive_ttl, max_ttl);
+  negative_ttl = std::min(negative_ttl, max_ttl);
+  size_t entries = max_entries >= (double) std::numeric_limits < size_t >::max() ?
+    std::numeric_limits < size_t >::max() : (size_t) max_entries;
+  dns_cache::instance().configure(entries, positive_ttl, negative_ttl);
+  return dns_cache_stats();
+}
@@ -0,0 +1,199 @@
+#ifndef __DNS_CACHE__
+#define __DNS_CACHE__
+
+#include <stdint.h>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A process-wide cache of DNS answers, shared by every lookup function.
+ *
+ * Entries are keyed on the query (prefixed to keep forward and reverse
+ * lookups apart) and expire after a positive or negative TTL depending on
+ * whether the lookup succeeded. When the cache is full the least recently
+ * used entry is evicted. All members are safe to call from any thread.
+ */
+class dns_cache {
+
+public:
+
+  typedef std::chrono::steady_clock clock;
+
+  /**
+   * Counters describing the cache's state and how it has been used.
+   */
+  struct stats {
+    size_t entries;
+    size_t max_entries;
+    double positive_ttl;
+    double negative_ttl;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+  };
+
+  /**
+   * @return the cache.
+   */
+  static dns_cache& instance(){
+    static dns_cache cache;
+    return cache;
+  }
+
+  /**
+   * Look a query up.
+   *
+   * @param key the query key; see forward_key and reverse_key.
+   *
+   * @param answers where the cached answers are written on a hit.
+   *
+   * @param negative set to true on a hit for a query that failed to resolve.
+   *
+   * @return true on a hit, false on a miss (including an expired entry).
+   */
+  bool lookup(const std::string& key, std::vector < std::string >& answers, bool& negative){
+    std::lock_guard < std::mutex > guard(lock);
+    std::unordered_map < std::string, entry_list::iterator >::iterator it = index.find(key);
+    if (it == index.end()) {
+      misses++;
+      return false;
+    }
+    if (it->second->expires <= clock::now()) {
+      entries.erase(it->second);
+      index.erase(it);
+      misses++;
+      return false;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    answers = it->second->answers;
+    negative = it->second->negative;
+    hits++;
+    return true;
+  }
+
+  /**
+   * Add (or replace) an entry.
+   *
+   * @param key the query key.
+   *
+   * @param answers the answers the query resolved to; ignored when negative.
+   *
+   * @param negative true if the query failed to resolve.
+   */
+  void store(const std::string& key, const std::vector < std::string >& answers, bool negative){
+    std::lock_guard < std::mutex > guard(lock);
+    double ttl = negative ? negative_ttl : positive_ttl;
+    if (max_entries == 0 || ttl <= 0) {
+      return;
+    }
+    std::unordered_map < std::string, entry_list::iterator >::iterator it = index.find(key);
+    if (it != index.end()) {
+      entries.erase(it->second);
+      index.erase(it);
+    }
+    entry e;
+    e.key = key;
+    if (!negative) {
+      e.answers = answers;
+    }
+    e.negative = negative;
+    e.expires = clock::now() + std::chrono::duration_cast < clock::duration >(std::chrono::duration < double >(ttl));
+    entries.push_front(e);
+    index[key] = entries.begin();
+    while (entries.size() > max_entries) {
+      index.erase(entries.back().key);
+      entries.pop_back();
+      evictions++;
+    }
+  }
+
+  /**
+   * Change the cache's size and TTLs. Shrinking it evicts the least recently
+   * used entries; new TTLs only apply to entries stored from now on.
+   *
+   * @param new_max_entries the maximum number of entries; 0 turns the cache off.
+   *
+   * @param new_positive_ttl how long, in seconds, to keep answers.
+   *
+   * @param new_negative_ttl how long, in seconds, to remember failures; 0
+   * turns negative caching off.
+   */
+  void configure(size_t new_max_entries, double new_positive_ttl, double new_negative_ttl){
+    std::lock_guard < std::mutex > guard(lock);
+    max_entries = new_max_entries;
+    positive_ttl = new_positive_ttl;
+    negative_ttl = new_negative_ttl;
+    while (entries.size() > max_entries) {
+      index.erase(entries.back().key);
+      entries.pop_back();
+      evictions++;
+    }
+  }
+
+  /**
+   * Drop every entry and reset the counters.
+   */
+  void flush(){
+    std::lock_guard < std::mutex > guard(lock);
+    entries.clear();
+    index.clear();
+    hits = misses = evictions = 0;
+  }
+
+  /**
+   * @return the cache's current configuration and counters.
+   */
+  stats get_stats(){
+    std::lock_guard < std::mutex > guard(lock);
+    stats out;
+    out.entries = entries.size();
+    out.max_entries = max_entries;
+    out.positive_ttl = positive_ttl;
+    out.negative_ttl = negative_ttl;
+    out.hits = hits;
+    out.misses = misses;
+    out.evictions = evictions;
+    return out;
+  }
+
+  static std::string forward_key(const std::string& hostname){
+    return "h" + hostname;
+  }
+
+  static std::string reverse_key(const std::string& ip_address){
+    return "r" + ip_address;
+  }
+
+private:
+
+  struct entry {
+    std::string key;
+    std::vector < std::string > answers;
+    bool negative;
+    clock::time_point expires;
+  };
+
+  typedef std::list < entry > entry_list;
+
+  dns_cache() : max_entries(10000), positive_ttl(300), negative_ttl(60),
+    hits(0), misses(0), evictions(0) {}
+
+  dns_cache(const dns_cache&);
+  dns_cache& operator=(const dns_cache&);
+
+  std::mutex lock;
+  entry_list entries;
+  std::unordered_map < std::string, entry_list::iterator > index;
+  size_t max_entries;
+  double positive_ttl;
+  double negative_ttl;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include <Rcpp.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ip_parse.h"
+#include "prefix_table.h"
+
+using namespace Rcpp;
+
+/**
+ * The derived columns enrich_log can write, one per transform.
+ */
+enum enrich_transform {ENRICH_IP, ENRICH_CLASS, ENRICH_NUMERIC, ENRICH_MULTICAST, ENRICH_ASN};
+
+static const char* enrich_transform_names[] = {"ip", "class", "numeric", "multicast", "asn"};
+
+/**
+ * A FILE* that is closed however the function holding it exits (including
+ * via a user interrupt).
+ */
+struct enrich_file {
+  FILE* handle;
+  enrich_file(const std::string& path, const char* mode) : handle(fopen(path.c_str(), mode)) {}
+  ~enrich_file(){
+    if (handle) fclose(handle);
+  }
+};
+
+/**
+ * Find field number column (1-based) of a line.
+ *
+ * @return true (with the field's bounds written to begin and end) if the
+ * line has that many fields.
+ */
+static inline bool enrich_field(const char* line, const char* line_end, char sep, int column,
+                                const char** begin, const char** end){
+  const char* p = line;
+  for (int i = 1; i < column; i++) {
+    const char* next = (const char*) memchr(p, sep, line_end - p);
+    if (next == NULL) {
+      return false;
+    }
+    p = next + 1;
+  }
+  const char* next = (const char*) memchr(p, sep, line_end - p);
+  *begin = p;
+  *end = next == NULL ? line_end : next;
+  return true;
+}
+
+static inline void enrich_append_uint(std::string& out, uint32_t value){
+  char digits[10];
+  int n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (n) {
+    out += digits[--n];
+  }
+}
+
+//[[Rcpp::export]]
+double int_enrich_log(std::string input, std::string output, int column, int xff_column,
+                      std::vector < std::string > transforms, std::string sep, bool header,
+                      SEXP asn_table, int block_size){
+
+  if (column < 1) {
+    throw std::range_error("column must be a positive field number");
+  }
+  if (sep.size() != 1) {
+    throw std::range_error("sep must be a single character");
+  }
+  if (block_size < 1024) {
+    block_size = 1024;
+  }
+
+  std::vector < int > steps;
+  for (size_t i = 0; i < transforms.size(); i++) {
+    int found = -1;
+    for (int t = ENRICH_IP; t <= ENRICH_ASN; t++) {
+      if (transforms[i] == enrich_transform_names[t]) {
+        found = t;
+      }
+    }
+    if (found < 0) {
+      throw std::range_error("Unknown transform: " + transforms[i]);
+    }
+    steps.push_back(found);
+  }
+
+  labelled_prefix_table* asn = NULL;
+  if (std::find(steps.begin(), steps.end(), (int) ENRICH_ASN) != steps.end()) {
+    asn = get_prefix_table(asn_table);
+  }
+
+  enrich_file in(input, "rb");
+  if (in.handle == NULL) {
+    throw std::range_error("Cannot open " + input);
+  }
+  enrich_file out(output, "wb");
+  if (out.handle == NULL) {
+    throw std::range_error("Cannot open " + output + " for writing");
+  }
+
+  const char delimiter = sep[0];
+  std::vector < char > buffer(block_size);
+  std::string written;
+  size_t filled = 0;
+  double lines = 0;
+  bool skip_header = header;
+
+  if (header) {
+    for (size_t t = 0; t < steps.size(); t++) {
+      if (t) written += delimiter;
+      written += enrich_transform_names[steps[t]];
+    }
+    written += '\n';
+  }
+
+  for (;;) {
+
+    // a line longer than the block grows the buffer; otherwise memory stays at one block
+    if (filled == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+    size_t got = fread(&buffer[filled], 1, buffer.size() - filled, in.handle);
+    if (got == 0 && ferror(in.handle)) {
+      throw std::range_error("Error reading " + input);
+    }
+    bool eof = got == 0;
+    filled += got;
+
+    const char* p = &buffer[0];
+    const char* block_end = p + filled;
+
+    while (p < block_end) {
+      const char* line_end = (const char*) memchr(p, '\n', block_end - p);
+      const char* next;
+      if (line_end == NULL) {
+        if (!eof) {
+          break;
+        }
+        line_end = next = block_end;
+      } else {
+        next = line_end + 1;
+      }
+      if (line_end > p && line_end[-1] == '\r') {
+        line_end--;
+      }
+
+      if (skip_header) {
+        skip_header = false;
+        p = next;
+        continue;
+      }
+
+      const char *address = NULL, *address_end = NULL;
+      bool present = enrich_field(p, line_end, delimiter, column, &address, &address_end);
+      if (xff_column > 0) {
+        const char *xff, *xff_end;
+        size_t hop_len;
+        long hop;
+        if (enrich_field(p, line_end, delimiter, xff_column, &xff, &xff_end) &&
+            (hop = xff_first_hop(xff, xff_end - xff, &hop_len)) >= 0) {
+          address = xff + hop;
+          address_end = address + hop_len;
+          present = true;
+        }
+      }
+
+      // each address is parsed once, whatever the transforms
+      uint32_t v4 = 0;
+      uint8_t v6[16];
+      int family = 0;
+      if (present) {
+        if (parse_ipv4(address, address_end - address, &v4) == IP_PARSE_OK) {
+          family = 4;
+        } else if (parse_ipv6(address, address_end - address, v6) == IP_PARSE_OK) {
+          family = 6;
+        }
+      }
+
+      for (size_t t = 0; t < steps.size(); t++) {
+        if (t) written += delimiter;
+        switch (steps[t]) {
+        case ENRICH_IP:
+          if (present) {
+            written.append(address, address_end - address);
+          } else {
+            written += "NA";
+          }
+          break;
+        case ENRICH_CLASS:
+          written += family == 4 ? "IPv4" : family == 6 ? "IPv6" : "NA";
+          break;
+        case ENRICH_NUMERIC:
+          enrich_append_uint(written, family == 4 ? v4 : 0);
+          break;
+        case ENRICH_MULTICAST:
+          if (family == 4) {
+            written += (v4 & 0xf0000000) == 0xe0000000 ? "TRUE" : "FALSE";
+          } else if (family == 6) {
+            written += v6[0] == 0xff ? "TRUE" : "FALSE";
+          } else {
+            written += "NA";
+          }
+          break;
+        case ENRICH_ASN: {
+          int32_t hit = family == 4 ? asn->table.lookup(v4) : prefix_table::no_match;
+          written += hit == prefix_table::no_match ? std::string("NA") : asn->labels[hit];
+          break;
+        }
+        }
+      }
+      written += '\n';
+      lines++;
+      p = next;
+    }
+
+    // carry the incomplete last line over to the next block
+    filled = block_end - p;
+    memmove(&buffer[0], p, filled);
+
+    if (fwrite(written.data(), 1, written.size(), out.handle) != written.size()) {
+      throw std::range_error("Error writing " + output);
+    }
+    written.clear();
+
+    if (eof) {
+      break;
+    }
+    Rcpp::checkUserInterrupt();
+  }
+
+  return lines;
+}
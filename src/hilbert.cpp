@@ -1,4 +1,11 @@
 #include <Rcpp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <cmath>
+
+#include "ip_parse.h"
+#include "packed_ip.h"
+#include "parallel.h"
 
 using namespace Rcpp;
 
@@ -7,6 +14,115 @@ int addr_space_bits_per_pixel = 8;	/* /24 */
 unsigned int addr_space_first_addr = 0;
 unsigned int addr_space_last_addr = ~0;
 
+/**
+ * The Hilbert curve state machine, expanded into lookup tables that step it
+ * four levels (eight bits of address, four bits of each coordinate) at a
+ * time rather than one.
+ */
+struct hilbert_tables {
+
+  /**
+   * Indexed by state and address byte: the x nibble, the y nibble << 4 and
+   * the next state << 8.
+   */
+  uint16_t encode[4][256];
+
+  /**
+   * Indexed by state and (x nibble << 4 | y nibble): the address byte and
+   * the next state << 8.
+   */
+  uint16_t decode[4][256];
+
+  /**
+   * Indexed by state and (x bit << 1 | y bit): the address digit and the
+   * next state << 2; for stepping a single level.
+   */
+  uint8_t inverse[4][4];
+
+  hilbert_tables(){
+    for (unsigned state = 0; state < 4; state++) {
+      for (unsigned digit = 0; digit < 4; digit++) {
+        unsigned row = 4 * state | digit;
+        unsigned pos = ((0x936C >> row) & 1) << 1 | ((0x39C6 >> row) & 1);
+        inverse[state][pos] = (uint8_t) (digit | next_state(state, digit) << 2);
+      }
+    }
+    for (unsigned state = 0; state < 4; state++) {
+      for (unsigned byte = 0; byte < 256; byte++) {
+        unsigned s = state, x = 0, y = 0;
+        for (int i = 6; i >= 0; i -= 2) {
+          unsigned row = 4 * s | ((byte >> i) & 3);
+          x = (x << 1) | ((0x936C >> row) & 1);
+          y = (y << 1) | ((0x39C6 >> row) & 1);
+          s = next_state(s, (byte >> i) & 3);
+        }
+        encode[state][byte] = (uint16_t) (x | y << 4 | s << 8);
+        decode[state][x << 4 | y] = (uint16_t) (byte | s << 8);
+      }
+    }
+  }
+
+  static unsigned next_state(unsigned state, unsigned digit){
+    return (0x3E6B94C1 >> 2 * (4 * state | digit)) & 3;
+  }
+};
+
+static const hilbert_tables hilbert_lut;
+
+/**
+ * Map the top 2 * order bits of s to a point on a Hilbert curve of the
+ * given order.
+ */
+static inline void hilbert_point(uint32_t s, int order, uint32_t* px, uint32_t* py){
+  unsigned state = 0, x = 0, y = 0;
+  int i = 2 * order - 2;
+  // the levels that don't fill a whole byte go one at a time
+  for (int lead = order % 4; lead > 0; lead--, i -= 2) {
+    unsigned row = 4 * state | ((s >> i) & 3);
+    x = (x << 1) | ((0x936C >> row) & 1);
+    y = (y << 1) | ((0x39C6 >> row) & 1);
+    state = (0x3E6B94C1 >> 2 * row) & 3;
+  }
+  for (i -= 6; i >= 0; i -= 8) {
+    uint16_t step = hilbert_lut.encode[state][(s >> i) & 0xff];
+    x = (x << 4) | (step & 0xf);
+    y = (y << 4) | ((step >> 4) & 0xf);
+    state = step >> 8;
+  }
+  *px = x;
+  *py = y;
+}
+
+/**
+ * The inverse of hilbert_point: the 2 * order bit curve index of (x, y).
+ */
+static inline uint32_t hilbert_index(uint32_t x, uint32_t y, int order){
+  unsigned state = 0;
+  uint32_t s = 0;
+  int level = order - 1;
+  for (int lead = order % 4; lead > 0; lead--, level--) {
+    uint8_t step = hilbert_lut.inverse[state][((x >> level) & 1) << 1 | ((y >> level) & 1)];
+    s = (s << 2) | (step & 3);
+    state = step >> 2;
+  }
+  for (level -= 3; level >= 0; level -= 4) {
+    uint16_t step = hilbert_lut.decode[state][((x >> level) & 0xf) << 4 | ((y >> level) & 0xf)];
+    s = (s << 8) | (step & 0xff);
+    state = step >> 8;
+  }
+  return s;
+}
+
+/**
+ * @return the curve order for bpp, throwing if it is out of [min_bpp, 32] or odd.
+ */
+static int hilbert_order(int bpp, int min_bpp){
+  if (bpp == NA_INTEGER || bpp < min_bpp || bpp > addr_space_bits_per_image || bpp % 2) {
+    throw std::range_error("bpp must be an even number from " + std::to_string(min_bpp) + " to 32");
+  }
+  return (addr_space_bits_per_image - bpp) / 2;
+}
+
 //' Encode an IPv4 address to Hilbert space
 //'
 //' @param x IPv4 address
@@ -23,15 +139,8 @@ NumericMatrix hilbert_encode(std::vector<unsigned> x, int bpp=8) {
 
     unsigned s = ((unsigned)x[n] - addr_space_first_addr) >> bpp;
 
-    unsigned state=0, x=0, y=0, row=0;
-    int i;
-
-    for (i=2*order-2; i>=0; i-=2) {
-      row = 4 * state | ((s >> i) & 3);
-      x = (x << 1) | ((0x936C >> row) & 1);
-      y = (y << 1) | ((0x39C6 >> row) & 1);
-      state = (0x3E6B94C1 >> 2 * row) & 3;
-    }
+    uint32_t x, y;
+    hilbert_point(s, order, &x, &y);
 
     res(n, 0) = x;
     res(n, 1) = y;
@@ -41,3 +150,142 @@ NumericMatrix hilbert_encode(std::vector<unsigned> x, int bpp=8) {
   return(res);
 
 }
+
+//' Bin IPv4 addresses into a Hilbert curve heatmap
+//'
+//' \code{hilbert_heatmap} places each address on the same Hilbert curve as
+//' \code{\link{hilbert_encode}} and counts (or sums the weights of) the
+//' addresses falling in each pixel, without building the coordinate matrix.
+//'
+//' @param x a vector of IPv4 addresses, either numeric (as
+//'        \code{\link{ip_to_numeric}} returns) or character/packed. Anything
+//'        that isn't a valid IPv4 address is skipped.
+//' @param bpp the number of address bits each pixel covers: an even number from 8
+//'        (each pixel a /24, a 4096x4096 matrix) to 32.
+//' @param weights optional numeric weights, one per address, to sum instead of
+//'        counting. \code{NA} weights are skipped.
+//' @return a square numeric matrix with \code{2^((32 - bpp) / 2)} rows, where the
+//'         pixel at \code{hilbert_encode()} coordinates \code{(x, y)} is
+//'         element \code{[x + 1, y + 1]}, ready for \code{image()}.
+//' @seealso \code{\link{hilbert_decode}} to find the CIDR block a pixel covers.
+//' @examples
+//' hilbert_heatmap(c("0.0.0.1", "0.0.0.2", "255.255.255.255"), bpp = 28)
+//' @export
+// [[Rcpp::export]]
+NumericMatrix hilbert_heatmap(SEXP x, int bpp = 8, SEXP weights = R_NilValue) {
+
+  int order = hilbert_order(bpp, 8);
+  R_xlen_t input_size = Rf_xlength(x);
+  const double* weight = NULL;
+  NumericVector weight_values;
+  if (!Rf_isNull(weights)) {
+    weight_values = NumericVector(weights);
+    if (weight_values.size() != input_size) {
+      throw std::range_error("weights must be the same length as x");
+    }
+    weight = weight_values.begin();
+  }
+
+  const double* numbers = NULL;
+  NumericVector number_values;
+  if (TYPEOF(x) == REALSXP || TYPEOF(x) == INTSXP) {
+    number_values = NumericVector(x);
+    numbers = number_values.begin();
+  }
+  address_reader ips(numbers ? (SEXP) CharacterVector(0) : x);
+
+  uint32_t side = 1u << order;
+  NumericMatrix res(side, side);
+  double* cells = res.begin();
+
+  // the pixels are found in parallel a block at a time, and then tallied in order
+  const R_xlen_t block_size = 1 << 20;
+  std::vector < int64_t > pixel(std::min(input_size, block_size));
+
+  for (R_xlen_t block = 0; block < input_size; block += block_size) {
+    R_xlen_t block_end = std::min(input_size, block + block_size);
+    parallel_for(block_end - block, [&](R_xlen_t begin, R_xlen_t end){
+      for (R_xlen_t i = begin; i < end; i++) {
+        uint32_t address;
+        bool valid;
+        if (numbers) {
+          double value = numbers[block + i];
+          valid = value >= 0 && value <= 4294967295.0 && value == (double) (uint32_t) value;
+          address = valid ? (uint32_t) value : 0;
+        } else {
+          valid = ips.v4(block + i, &address);
+        }
+        uint32_t px, py;
+        if (valid) {
+          hilbert_point(bpp == 32 ? 0 : (address - addr_space_first_addr) >> bpp, order, &px, &py);
+          pixel[i] = (int64_t) py * side + px;
+        } else {
+          pixel[i] = -1;
+        }
+      }
+    });
+    for (R_xlen_t i = 0; i < block_end - block; i++) {
+      if (pixel[i] < 0) {
+        continue;
+      }
+      if (weight) {
+        if (!ISNAN(weight[block + i])) {
+          cells[pixel[i]] += weight[block + i];
+        }
+      } else {
+        cells[pixel[i]] += 1;
+      }
+    }
+  }
+
+  return res;
+}
+
+//' Find the CIDR block a Hilbert curve pixel covers
+//'
+//' \code{hilbert_decode} is the inverse of \code{\link{hilbert_encode}}: it
+//' turns pixel coordinates back into the block of addresses the pixel covers.
+//'
+//' @param x the pixels' x coordinates (the first column of
+//'        \code{hilbert_encode()}'s result, or a heatmap row number minus one).
+//' @param y the pixels' y coordinates, the same length as \code{x}.
+//' @param bpp the number of address bits each pixel covers: an even number from 0
+//'        to 32, as passed to \code{hilbert_encode()}.
+//' @return a character vector of CIDR blocks, \code{NA} where a coordinate is
+//'         missing or off the curve.
+//' @examples
+//' hilbert_decode(hilbert_encode(ip_to_numeric("192.168.1.1"), bpp = 8)[, 1],
+//'                hilbert_encode(ip_to_numeric("192.168.1.1"), bpp = 8)[, 2])
+//' #[1] "192.168.1.0/24"
+//' @export
+// [[Rcpp::export]]
+CharacterVector hilbert_decode(NumericVector x, NumericVector y, int bpp = 8) {
+
+  int order = hilbert_order(bpp, 0);
+  if (x.size() != y.size()) {
+    throw std::range_error("x and y must be the same length");
+  }
+
+  R_xlen_t input_size = x.size();
+  CharacterVector output(input_size);
+  double side = std::ldexp(1.0, order);
+  char buffer[20];
+
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+    if (!(x[i] >= 0 && x[i] < side && y[i] >= 0 && y[i] < side) ||
+        x[i] != (double) (uint32_t) x[i] || y[i] != (double) (uint32_t) y[i]) {
+      output[i] = NA_STRING;
+      continue;
+    }
+    uint32_t s = hilbert_index((uint32_t) x[i], (uint32_t) y[i], order);
+    uint32_t network = bpp == 32 ? addr_space_first_addr : (s << bpp) + addr_space_first_addr;
+    size_t len = format_ipv4(network, buffer);
+    len += snprintf(buffer + len, sizeof(buffer) - len, "/%d", addr_space_bits_per_image - bpp);
+    SET_STRING_ELT(output, i, Rf_mkCharLen(buffer, (int) len));
+  }
+
+  return output;
+}
@@ -0,0 +1,137 @@
+#include <Rcpp.h>
+
+#include "cidr.h"
+#include "interval_table.h"
+#include "packed_ip.h"
+#include "parallel.h"
+#include "stats.h"
+
+using namespace Rcpp;
+
+/**
+ * The compiled form of the IANA special-purpose and address space
+ * registries: each maps an address to the row of its registry whose block
+ * holds it (the most specific block, where they nest).
+ */
+struct iana_table {
+  interval_table special_v4;
+  interval_table special_v6;
+  interval_table registry_v4;
+  interval_table registry_v6;
+};
+
+static iana_table* get_iana_table(SEXP tbl){
+  if (TYPEOF(tbl) != EXTPTRSXP || !Rf_inherits(tbl, "iptools_iana_table")) {
+    throw std::range_error("Not a compiled IANA table");
+  }
+  iana_table* ptr = (iana_table*) R_ExternalPtrAddr(tbl);
+  if (ptr == NULL) {
+    throw std::range_error("The IANA table is no longer valid (was it saved and reloaded?)");
+  }
+  return ptr;
+}
+
+/**
+ * Compile a registry's address blocks into v4 and v6, labelling each with
+ * its row. A row may list several blocks, separated by commas
+ * ("192.0.0.170/32, 192.0.0.171/32"); blocks that don't parse are skipped.
+ */
+static void iana_table_add(CharacterVector blocks, interval_table& v4, interval_table& v6){
+
+  std::vector < interval_table::entry > v4_entries, v6_entries;
+  uint128 address;
+  int prefix;
+
+  for (R_xlen_t i = 0; i < blocks.size(); i++) {
+    SEXP str = STRING_ELT(blocks, i);
+    if (str == NA_STRING) {
+      continue;
+    }
+    const char* row = CHAR(str);
+    size_t row_len = LENGTH(str), start = 0;
+    while (start < row_len) {
+      size_t end = start;
+      while (end < row_len && row[end] != ',') {
+        end++;
+      }
+      size_t first = start, last = end;
+      while (first < last && row[first] == ' ') {
+        first++;
+      }
+      while (last > first && row[last - 1] == ' ') {
+        last--;
+      }
+      start = end + 1;
+      int family = cidr_parse(row + first, last - first, &address, &prefix);
+      if (!family || prefix < 0 || prefix > cidr_bits(family)) {
+        continue;
+      }
+      uint128 network = address & cidr_net_mask(family, prefix);
+      interval_table::entry block(network, network | cidr_host_mask(family, prefix), (int) i);
+      (family == 4 ? v4_entries : v6_entries).push_back(block);
+    }
+  }
+
+  v4.build(v4_entries);
+  v6.build(v6_entries);
+}
+
+// [[Rcpp::export]]
+SEXP iana_table_build(CharacterVector special_blocks, CharacterVector registry_blocks) {
+
+  XPtr < iana_table > out(new iana_table, true);
+  iana_table_add(special_blocks, out->special_v4, out->special_v6);
+  iana_table_add(registry_blocks, out->registry_v4, out->registry_v6);
+  out.attr("class") = "iptools_iana_table";
+
+  return out;
+}
+
+// [[Rcpp::export]]
+List iana_table_lookup(SEXP tbl, SEXP ip_addresses) {
+
+  const iana_table* ptr = get_iana_table(tbl);
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
+  stats_call stats(STATS_IP_TO_IANA, input_size);
+  IntegerVector special(input_size), registry(input_size);
+  int *special_row = INTEGER(special), *registry_row = INTEGER(registry);
+  std::atomic < R_xlen_t > invalid(0);
+
+  // both registries are looked up in the same pass over the addresses
+  parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+    uint32_t v4;
+    uint8_t v6[16];
+    R_xlen_t chunk_invalid = 0;
+    for (R_xlen_t i = begin; i < end; i++) {
+      int special_hit = interval_table::no_match, registry_hit = interval_table::no_match;
+      switch (ips.family(i, &v4, v6)) {
+      case PACKED_V4:
+        special_hit = ptr->special_v4.lookup(uint128(0, v4));
+        registry_hit = ptr->registry_v4.lookup(uint128(0, v4));
+        break;
+      case PACKED_V6: {
+        uint128 address = uint128::from_bytes(v6);
+        special_hit = ptr->special_v6.lookup(address);
+        registry_hit = ptr->registry_v6.lookup(address);
+        break;
+      }
+      default:
+        chunk_invalid++;
+      }
+      special_row[i] = special_hit == interval_table::no_match ? NA_INTEGER : special_hit + 1;
+      registry_row[i] = registry_hit == interval_table::no_match ? NA_INTEGER : registry_hit + 1;
+    }
+    invalid.fetch_add(chunk_invalid, std::memory_order_relaxed);
+  });
+  stats.invalid(invalid.load());
+
+  return List::create(_["special"] = special, _["registry"] = registry);
+}
+
+// [[Rcpp::export]]
+NumericVector iana_table_size(SEXP tbl) {
+  const iana_table* ptr = get_iana_table(tbl);
+  return NumericVector::create((double) (ptr->special_v4.size() + ptr->special_v6.size()),
+                               (double) (ptr->registry_v4.size() + ptr->registry_v6.size()));
+}
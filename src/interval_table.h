@@ -0,0 +1,121 @@
+#ifndef __INTERVAL_TABLE__
+#define __INTERVAL_TABLE__
+
+#include <algorithm>
+#include <vector>
+
+#include "cidr.h"
+
+/**
+ * A sorted table of disjoint, labelled address intervals, looked up with
+ * a binary search. It is built from CIDR blocks (or any intervals that
+ * either nest or don't overlap); where blocks nest, the innermost one's
+ * label wins, as with a longest-prefix match.
+ */
+class interval_table {
+
+public:
+
+  /**
+   * The value returned by lookup() for addresses no interval covers.
+   */
+  static const int no_match = -1;
+
+  interval_table() : input_count(0) {}
+
+  /**
+   * An input interval: [first, last] carries label.
+   */
+  struct entry {
+    uint128 first;
+    uint128 last;
+    int label;
+    entry(const uint128& f, const uint128& l, int lab) : first(f), last(l), label(lab) {}
+  };
+
+  /**
+   * Build the table, replacing any existing contents. entries is sorted in
+   * place.
+   */
+  void build(std::vector < entry >& entries){
+
+    starts.clear();
+    ends.clear();
+    labels.clear();
+    input_count = entries.size();
+
+    // outer intervals sort before the intervals nested inside them
+    std::sort(entries.begin(), entries.end(), outer_first);
+
+    // sweep through the intervals, keeping a stack of the ones still open
+    // and emitting the stretch covered by whichever is innermost
+    std::vector < const entry* > open;
+    uint128 cursor;
+    bool exhausted = false;
+    for (size_t i = 0; i <= entries.size(); i++) {
+      const entry* next = i < entries.size() ? &entries[i] : NULL;
+      while (!open.empty() && (next == NULL || open.back()->last < next->first)) {
+        const entry* top = open.back();
+        if (!exhausted && cursor <= top->last) {
+          emit(cursor, top->last, top->label);
+          exhausted = top->last == cidr_max(6);
+          cursor = top->last.plus_one();
+        }
+        open.pop_back();
+      }
+      if (next == NULL) {
+        break;
+      }
+      if (!open.empty() && !exhausted && cursor < next->first) {
+        emit(cursor, next->first.minus_one(), open.back()->label);
+      }
+      if (open.empty() || !exhausted) {
+        cursor = next->first;
+        exhausted = false;
+      }
+      open.push_back(next);
+    }
+  }
+
+  /**
+   * @return the label of the innermost interval covering address, or no_match.
+   */
+  inline int lookup(const uint128& address) const {
+    std::vector < uint128 >::const_iterator hit = std::upper_bound(starts.begin(), starts.end(), address);
+    if (hit == starts.begin()) {
+      return no_match;
+    }
+    size_t i = (hit - starts.begin()) - 1;
+    return ends[i] >= address ? labels[i] : no_match;
+  }
+
+  /**
+   * @return the number of intervals the table was built from.
+   */
+  size_t size() const {
+    return input_count;
+  }
+
+private:
+  std::vector < uint128 > starts;
+  std::vector < uint128 > ends;
+  std::vector < int > labels;
+  size_t input_count;
+
+  static bool outer_first(const entry& a, const entry& b){
+    return a.first < b.first || (a.first == b.first && a.last > b.last);
+  }
+
+  void emit(const uint128& first, const uint128& last, int label){
+    // adjacent stretches with the same label become one
+    if (!labels.empty() && labels.back() == label && ends.back().plus_one() == first) {
+      ends.back() = last;
+      return;
+    }
+    starts.push_back(first);
+    ends.push_back(last);
+    labels.push_back(label);
+  }
+};
+
+#endif
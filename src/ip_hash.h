@@ -0,0 +1,119 @@
+#ifndef __IP_HASH__
+#define __IP_HASH__
+
+#include <stdint.h>
+#include <stdexcept>
+#include <vector>
+
+#include "cidr.h"
+
+/**
+ * Scramble a 64-bit value so that addresses differing only in their low
+ * bits land far apart (the splitmix64 finaliser).
+ */
+static inline uint64_t ip_hash_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb3fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+static inline uint64_t ip_hash_key(uint32_t key) {
+  return ip_hash_mix(key);
+}
+
+static inline uint64_t ip_hash_key(const uint128& key) {
+  return ip_hash_mix(key.hi ^ ip_hash_mix(key.lo));
+}
+
+/**
+ * Counts occurrences of address keys (uint32_t or uint128) in an
+ * open-addressing hash table with linear probing. The distinct keys and
+ * their counts are kept densely, in the order they were first seen, and
+ * the slots only hold indices into them, so memory grows with the number
+ * of distinct keys rather than with the input.
+ */
+template < typename Key >
+class ip_hash_counter {
+
+public:
+
+  ip_hash_counter() : slots(16, 0), mask(15), last(0) {}
+
+  /**
+   * Count one occurrence of key.
+   *
+   * @return the key's index in keys() and counts().
+   */
+  size_t add(const Key& key) {
+    // repeats of the previous key (common in logs) skip the probe
+    if (!keys_.empty() && keys_[last] == key) {
+      counts_[last]++;
+      return last;
+    }
+    size_t slot = ip_hash_key(key) & mask;
+    while (slots[slot]) {
+      size_t index = slots[slot] - 1;
+      if (keys_[index] == key) {
+        counts_[index]++;
+        return last = index;
+      }
+      slot = (slot + 1) & mask;
+    }
+    if (keys_.size() >= max_keys) {
+      throw std::range_error("too many distinct addresses to count");
+    }
+    slots[slot] = (uint32_t) keys_.size() + 1;
+    keys_.push_back(key);
+    counts_.push_back(1);
+    // keep the load factor at or below a half
+    if (2 * keys_.size() > slots.size()) {
+      grow();
+    }
+    return last = keys_.size() - 1;
+  }
+
+  size_t size() const {
+    return keys_.size();
+  }
+
+  /**
+   * @return the distinct keys, in the order they were first seen.
+   */
+  const std::vector < Key >& keys() const {
+    return keys_;
+  }
+
+  /**
+   * @return the number of times each of keys() was added.
+   */
+  const std::vector < uint64_t >& counts() const {
+    return counts_;
+  }
+
+private:
+
+  static const size_t max_keys = 0xfffffffeU;
+
+  std::vector < uint32_t > slots;
+  size_t mask;
+  std::vector < Key > keys_;
+  std::vector < uint64_t > counts_;
+  size_t last;
+
+  void grow() {
+    std::vector < uint32_t >(2 * slots.size(), 0).swap(slots);
+    mask = slots.size() - 1;
+    for (size_t index = 0; index < keys_.size(); index++) {
+      size_t slot = ip_hash_key(keys_[index]) & mask;
+      while (slots[slot]) {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = (uint32_t) index + 1;
+    }
+  }
+};
+
+#endif
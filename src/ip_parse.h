@@ -0,0 +1,418 @@
+#ifndef __IP_PARSE__
+#define __IP_PARSE__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Result codes for the address parsers. Anything other than
+ * IP_PARSE_OK means the input was rejected.
+ */
+enum ip_parse_status {
+  IP_PARSE_OK = 0,
+  IP_PARSE_EMPTY,       // zero-length input
+  IP_PARSE_BAD_LENGTH,  // too short or too long to be an address
+  IP_PARSE_BAD_CHAR,    // something other than digits and dots
+  IP_PARSE_BAD_FORMAT,  // wrong number of octets, empty octet, leading zero
+  IP_PARSE_OUT_OF_RANGE // an octet above 255
+};
+
+/**
+ * Convert one dotted-decimal field to its value. The caller has already
+ * checked that the field is 1-3 digits long.
+ */
+static inline int ipv4_octet(const char *field, size_t len) {
+  switch (len) {
+  case 1:
+    return field[0] - '0';
+  case 2:
+    return (field[0] - '0') * 10 + (field[1] - '0');
+  default:
+    return (field[0] - '0') * 100 + (field[1] - '0') * 10 + (field[2] - '0');
+  }
+}
+
+/**
+ * Scalar IPv4 parser; also the fallback where SSE2 isn't available.
+ */
+static inline int parse_ipv4_scalar(const char *str, size_t len, uint32_t *out) {
+
+  uint32_t result = 0;
+  int octets = 0;
+  size_t field = 0;
+
+  for (size_t i = 0; i <= len; i++) {
+    if (i == len || str[i] == '.') {
+      size_t field_len = i - field;
+      if (field_len == 0 || field_len > 3 || ++octets > 4) return IP_PARSE_BAD_FORMAT;
+      if (field_len > 1 && str[field] == '0') return IP_PARSE_BAD_FORMAT;
+      int octet = ipv4_octet(str + field, field_len);
+      if (octet > 255) return IP_PARSE_OUT_OF_RANGE;
+      result = (result << 8) | octet;
+      field = i + 1;
+    } else if ((unsigned char)(str[i] - '0') > 9) {
+      return IP_PARSE_BAD_CHAR;
+    }
+  }
+
+  if (octets != 4) return IP_PARSE_BAD_FORMAT;
+
+  *out = result;
+  return IP_PARSE_OK;
+}
+
+/**
+ * Parse a dotted-decimal IPv4 address ("162.243.111.4") without
+ * exceptions or locale lookups. Accepts exactly what inet_pton(AF_INET)
+ * does: four decimal octets, no leading zeros, no whitespace.
+ *
+ * @param str the characters to parse; need not be NUL-terminated.
+ *
+ * @param len the number of characters in str.
+ *
+ * @param out where the address is written, in host byte order. Only
+ * written on success.
+ *
+ * @return IP_PARSE_OK, or the ip_parse_status describing the failure.
+ */
+static inline int parse_ipv4(const char *str, size_t len, uint32_t *out) {
+
+  if (len == 0) return IP_PARSE_EMPTY;
+  if (len < 7 || len > 15) return IP_PARSE_BAD_LENGTH;
+
+#if defined(__SSE2__)
+  // classify all (up to 15) characters at once: every byte must be a digit
+  // or a dot, and there must be exactly three dots
+  char buf[16] = { 0 };
+  memcpy(buf, str, len);
+  __m128i chars = _mm_loadu_si128((const __m128i *) buf);
+  __m128i shifted = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(9)), shifted);
+  __m128i dots = _mm_cmpeq_epi8(chars, _mm_set1_epi8('.'));
+
+  unsigned int used = (1U << len) - 1;
+  unsigned int dot_mask = (unsigned int) _mm_movemask_epi8(dots) & used;
+  unsigned int digit_mask = (unsigned int) _mm_movemask_epi8(digits) & used;
+
+  if ((dot_mask | digit_mask) != used) return IP_PARSE_BAD_CHAR;
+
+  // locate the dots; any count other than three falls out as a bad field
+  size_t starts[5];
+  int fields = 0;
+  starts[0] = 0;
+  while (dot_mask && fields < 4) {
+    starts[++fields] = __builtin_ctz(dot_mask) + 1;
+    dot_mask &= dot_mask - 1;
+  }
+  if (fields != 3 || dot_mask) return IP_PARSE_BAD_FORMAT;
+  starts[4] = len + 1;
+
+  uint32_t result = 0;
+  for (int f = 0; f < 4; f++) {
+    size_t field_len = starts[f + 1] - starts[f] - 1;
+    if (field_len == 0 || field_len > 3) return IP_PARSE_BAD_FORMAT;
+    if (field_len > 1 && buf[starts[f]] == '0') return IP_PARSE_BAD_FORMAT;
+    int octet = ipv4_octet(buf + starts[f], field_len);
+    if (octet > 255) return IP_PARSE_OUT_OF_RANGE;
+    result = (result << 8) | octet;
+  }
+
+  *out = result;
+  return IP_PARSE_OK;
+#else
+  return parse_ipv4_scalar(str, len, out);
+#endif
+}
+
+/**
+ * Convenience overload for NUL-terminated strings.
+ */
+static inline int parse_ipv4(const char *str, uint32_t *out) {
+  return parse_ipv4(str, strlen(str), out);
+}
+
+/**
+ * Write the dotted-decimal form of an IPv4 address (host byte order) to
+ * out, which must have room for 15 characters. No terminating NUL is
+ * written.
+ *
+ * @return the number of characters written.
+ */
+static inline size_t format_ipv4(uint32_t ip, char *out) {
+  char *p = out;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    unsigned int octet = (ip >> shift) & 0xff;
+    if (octet >= 100) {
+      *p++ = '0' + octet / 100;
+      *p++ = '0' + (octet / 10) % 10;
+    } else if (octet >= 10) {
+      *p++ = '0' + octet / 10;
+    }
+    *p++ = '0' + octet % 10;
+    if (shift) *p++ = '.';
+  }
+  return p - out;
+}
+
+/**
+ * Format an IPv4 address as its 32-character bit string ("110000001010...").
+ * Writes exactly 32 characters and no terminating NUL.
+ */
+static inline size_t format_binary_string(uint32_t ip, char *out) {
+  for (int i = 31; i >= 0; i--) {
+    *out++ = '0' + ((ip >> i) & 1);
+  }
+  return 32;
+}
+
+/**
+ * Hex digit values, indexed by character; -1 for anything that isn't one.
+ */
+static const int8_t ip_hex_value[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const char ip_hex_digits[] = "0123456789abcdef";
+
+/**
+ * Parse an IPv6 address ("2001:db8::1", "::ffff:10.0.0.1", "fe80::1%eth0")
+ * without exceptions. Accepts what inet_pton(AF_INET6) does, plus the
+ * optional "%scope" suffix asio allows.
+ *
+ * @param str the characters to parse; need not be NUL-terminated.
+ *
+ * @param len the number of characters in str.
+ *
+ * @param out where the 16 address bytes are written, network order. Only
+ * written on success.
+ *
+ * @param scope if not NULL, receives the offset of the '%' that starts the
+ * scope suffix, or len if there isn't one.
+ *
+ * @return IP_PARSE_OK, or the ip_parse_status describing the failure.
+ */
+static inline int parse_ipv6(const char *str, size_t len, uint8_t *out, size_t *scope = NULL) {
+
+  if (len == 0) return IP_PARSE_EMPTY;
+
+  const char *pct = (const char *) memchr(str, '%', len);
+  size_t end = pct ? (size_t)(pct - str) : len;
+  if (scope) *scope = end;
+
+  if (end < 2 || end > 45) return IP_PARSE_BAD_LENGTH;
+
+  uint8_t tmp[16] = { 0 };
+  int groups = 0;     // 16-bit groups written so far
+  int gap = -1;       // group index where "::" sits
+  size_t i = 0;
+
+  if (str[0] == ':') {
+    if (str[1] != ':') return IP_PARSE_BAD_FORMAT;
+    gap = 0;
+    i = 2;
+    if (i == end) {
+      memcpy(out, tmp, 16);
+      return IP_PARSE_OK;
+    }
+  }
+
+  while (i < end) {
+
+    size_t field = i;
+    unsigned int value = 0;
+    int8_t h;
+
+    while (i < end && i - field < 4 && (h = ip_hex_value[(unsigned char) str[i]]) >= 0) {
+      value = (value << 4) | h;
+      i++;
+    }
+
+    if (i < end && str[i] == '.') {
+      // embedded dotted quad; must be the last thing and leave room for it
+      uint32_t v4;
+      if (groups > 6 || parse_ipv4(str + field, end - field, &v4) != IP_PARSE_OK) {
+        return IP_PARSE_BAD_FORMAT;
+      }
+      tmp[groups * 2] = (uint8_t)(v4 >> 24);
+      tmp[groups * 2 + 1] = (uint8_t)(v4 >> 16);
+      tmp[groups * 2 + 2] = (uint8_t)(v4 >> 8);
+      tmp[groups * 2 + 3] = (uint8_t) v4;
+      groups += 2;
+      i = end;
+      break;
+    }
+
+    if (i == field) {
+      return ip_hex_value[(unsigned char) str[i]] < 0 && str[i] != ':' ? IP_PARSE_BAD_CHAR : IP_PARSE_BAD_FORMAT;
+    }
+    if (groups == 8) return IP_PARSE_BAD_FORMAT;
+
+    tmp[groups * 2] = (uint8_t)(value >> 8);
+    tmp[groups * 2 + 1] = (uint8_t) value;
+    groups++;
+
+    if (i == end) break;
+    if (str[i] != ':') {
+      return ip_hex_value[(unsigned char) str[i]] >= 0 ? IP_PARSE_BAD_FORMAT : IP_PARSE_BAD_CHAR;
+    }
+    i++;
+    if (i == end) return IP_PARSE_BAD_FORMAT;  // trailing single ':'
+    if (str[i] == ':') {
+      if (gap >= 0) return IP_PARSE_BAD_FORMAT;
+      gap = groups;
+      i++;
+    }
+  }
+
+  if (gap >= 0) {
+    // "::" has to stand in for at least one group
+    if (groups == 8) return IP_PARSE_BAD_FORMAT;
+    int tail = groups - gap;
+    memmove(tmp + 16 - tail * 2, tmp + gap * 2, tail * 2);
+    memset(tmp + gap * 2, 0, (8 - groups) * 2);
+  } else if (groups != 8) {
+    return IP_PARSE_BAD_FORMAT;
+  }
+
+  memcpy(out, tmp, 16);
+  return IP_PARSE_OK;
+}
+
+/**
+ * Write the fully expanded form of an IPv6 address
+ * ("2001:0db8:0000:0000:0000:0000:0000:0001") to out, which must have
+ * room for 39 characters. No terminating NUL is written.
+ *
+ * @return the number of characters written (always 39).
+ */
+static inline size_t format_ipv6_expanded(const uint8_t *bytes, char *out) {
+  char *p = out;
+  for (int i = 0; i < 16; i++) {
+    *p++ = ip_hex_digits[bytes[i] >> 4];
+    *p++ = ip_hex_digits[bytes[i] & 0x0f];
+    if ((i & 1) && i < 15) *p++ = ':';
+  }
+  return p - out;
+}
+
+/**
+ * Write the canonical, compressed form of an IPv6 address ("2001:db8::1",
+ * RFC 5952, with IPv4-mapped and -compatible addresses written the way
+ * inet_ntop writes them) to out, which must have room for 45 characters.
+ * No terminating NUL is written.
+ *
+ * @return the number of characters written.
+ */
+static inline size_t format_ipv6_compressed(const uint8_t *bytes, char *out) {
+  unsigned int words[8];
+  int best_base = -1, best_len = 0, cur_base = -1, cur_len = 0;
+  char *p = out;
+
+  for (int i = 0; i < 8; i++) {
+    words[i] = ((unsigned int) bytes[2 * i] << 8) | bytes[2 * i + 1];
+    if (words[i] == 0) {
+      if (cur_base < 0) {
+        cur_base = i;
+        cur_len = 0;
+      }
+      cur_len++;
+      if (cur_len > best_len) {
+        best_base = cur_base;
+        best_len = cur_len;
+      }
+    } else {
+      cur_base = -1;
+    }
+  }
+  // a single zero word isn't worth compressing
+  if (best_len < 2) {
+    best_base = -1;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    if (i == best_base) {
+      *p++ = ':';
+      i += best_len - 1;
+      if (i == 7) *p++ = ':';
+      continue;
+    }
+    if (i) *p++ = ':';
+    if (i == 6 && best_base == 0 && (best_len == 6 || (best_len == 5 && words[5] == 0xffff))) {
+      uint32_t v4 = ((uint32_t) bytes[12] << 24) | ((uint32_t) bytes[13] << 16) |
+        ((uint32_t) bytes[14] << 8) | bytes[15];
+      p += format_ipv4(v4, p);
+      break;
+    }
+    bool started = false;
+    for (int shift = 12; shift >= 0; shift -= 4) {
+      unsigned int digit = (words[i] >> shift) & 0x0f;
+      if (digit || started || shift == 0) {
+        *p++ = ip_hex_digits[digit];
+        started = true;
+      }
+    }
+  }
+  return p - out;
+}
+
+/**
+ * Trim spaces and tabs from both ends of the string [*begin, *end).
+ */
+static inline void xff_trim(const char **begin, const char **end) {
+  while (*begin < *end && (**begin == ' ' || **begin == '\t')) (*begin)++;
+  while (*end > *begin && ((*end)[-1] == ' ' || (*end)[-1] == '\t')) (*end)--;
+}
+
+/**
+ * Find the first valid IPv4 or IPv6 address in a comma-separated
+ * X-Forwarded-For field, ignoring whitespace around each hop. A field of
+ * just "-" has none.
+ *
+ * @param hop_len where the address's length is written.
+ *
+ * @return the address's offset in field, or -1 if there isn't one.
+ */
+static inline long xff_first_hop(const char *field, size_t len, size_t *hop_len) {
+  const char *token = field;
+  const char *field_end = field + len;
+  uint32_t v4;
+  uint8_t v6[16];
+  if (len == 1 && *field == '-') {
+    return -1;
+  }
+  while (token <= field_end) {
+    const char *comma = (const char*) memchr(token, ',', field_end - token);
+    const char *token_end = comma == NULL ? field_end : comma;
+    const char *hop = token, *hop_end = token_end;
+    xff_trim(&hop, &hop_end);
+    if (parse_ipv4(hop, hop_end - hop, &v4) == IP_PARSE_OK ||
+        parse_ipv6(hop, hop_end - hop, v6) == IP_PARSE_OK) {
+      *hop_len = hop_end - hop;
+      return hop - field;
+    }
+    token = token_end + 1;
+  }
+  return -1;
+}
+
+#endif
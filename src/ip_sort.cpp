@@ -0,0 +1,159 @@
+#include <Rcpp.h>
+#include <climits>
+
+#include "ip_sort.h"
+#include "packed_ip.h"
+#include "parallel.h"
+#include "stats.h"
+
+using namespace Rcpp;
+
+/**
+ * The order that sorts a vector of addresses: IPv4 addresses, then IPv6
+ * addresses, each in numeric order (or, if decreasing, IPv6 then IPv4, each
+ * in reverse numeric order), then invalid elements and then NAs, each in
+ * their original order. Ties keep their original order too.
+ *
+ * Each address is parsed once (in parallel, with iptools.threads) and the
+ * two families are radix sorted separately, on 32- and 128-bit keys.
+ */
+static std::vector < R_xlen_t > ip_sort_order(SEXP ip_addresses, bool decreasing, const stats_call& stats){
+
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
+  std::vector < uint8_t > family(input_size);
+  std::vector < uint128 > keys(input_size);
+
+  parallel_for(input_size, [&](R_xlen_t begin, R_xlen_t end){
+    uint32_t v4;
+    uint8_t v6[16];
+    for (R_xlen_t i = begin; i < end; i++) {
+      family[i] = (uint8_t) ips.family(i, &v4, v6);
+      if (family[i] == PACKED_V4) {
+        keys[i] = uint128(0, decreasing ? ~v4 : v4);
+      } else if (family[i] == PACKED_V6) {
+        keys[i] = decreasing ? ~uint128::from_bytes(v6) : uint128::from_bytes(v6);
+      }
+    }
+  });
+
+  size_t v4_count = 0, v6_count = 0;
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    v4_count += family[i] == PACKED_V4;
+    v6_count += family[i] == PACKED_V6;
+  }
+  std::vector < ip_sort_record < uint32_t > > v4s;
+  std::vector < ip_sort_record < uint128 > > v6s;
+  std::vector < R_xlen_t > invalid, missing;
+  v4s.reserve(v4_count);
+  v6s.reserve(v6_count);
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    switch (family[i]) {
+    case PACKED_V4: {
+      ip_sort_record < uint32_t > record = { (uint32_t) keys[i].lo, (size_t) i };
+      v4s.push_back(record);
+      break;
+    }
+    case PACKED_V6: {
+      ip_sort_record < uint128 > record = { keys[i], (size_t) i };
+      v6s.push_back(record);
+      break;
+    }
+    case PACKED_NA:
+      missing.push_back(i);
+      break;
+    default:
+      invalid.push_back(i);
+    }
+  }
+  std::vector < uint128 >().swap(keys);
+  stats.invalid(invalid.size() + missing.size());
+
+  ip_radix_sort(v4s);
+  ip_radix_sort(v6s);
+
+  std::vector < R_xlen_t > order;
+  order.reserve(input_size);
+  for (int pass = 0; pass < 2; pass++) {
+    if ((pass == 0) != decreasing) {
+      for (size_t i = 0; i < v4s.size(); i++) order.push_back((R_xlen_t) v4s[i].index);
+    } else {
+      for (size_t i = 0; i < v6s.size(); i++) order.push_back((R_xlen_t) v6s[i].index);
+    }
+  }
+  order.insert(order.end(), invalid.begin(), invalid.end());
+  order.insert(order.end(), missing.begin(), missing.end());
+  return order;
+}
+
+//' @title Sort IP addresses
+//' @description \code{ip_order} returns the permutation that puts a vector of IP
+//' addresses in address order, and \code{ip_sort} the sorted addresses
+//' themselves. Unlike sorting the strings, "10.0.0.9" comes before "10.0.0.10",
+//' and IPv6 addresses sort by their value whichever way they are written.
+//'
+//' IPv4 addresses come first, then IPv6 addresses, then anything that isn't a
+//' valid address and finally \code{NA}s. With \code{decreasing = TRUE} the IPv6
+//' addresses come first, in decreasing order, then the IPv4 addresses, with
+//' invalid elements and \code{NA}s still last. The sort is stable: equal
+//' addresses, and the invalid elements and \code{NA}s, keep their original order.
+//'
+//' Each address is parsed once, and the IPv4 and IPv6 addresses are radix sorted
+//' on their 32- and 128-bit values, so this is much faster than
+//' \code{order(ip_to_numeric(x))} as well as working for IPv6. Parsing runs
+//' across threads if \code{options(iptools.threads)} is set.
+//'
+//' @param ip_addresses a character (or packed, see \code{\link{ip_pack}}) vector
+//'        of IP addresses.
+//' @param decreasing whether to sort in decreasing rather than increasing order.
+//' @return for \code{ip_order}, an integer vector of positions in
+//'         \code{ip_addresses}, as \code{\link{order}} returns; for \code{ip_sort},
+//'         \code{ip_addresses} rearranged into that order (packed, if
+//'         \code{ip_addresses} was packed).
+//' @examples
+//' ips <- c("10.0.0.10", "2001:db8::1", "junk", "10.0.0.9", NA, "::1", "9.255.255.255")
+//' ip_order(ips)
+//' ip_sort(ips)
+//' ip_sort(ips, decreasing = TRUE)
+//' @export
+// [[Rcpp::export]]
+SEXP ip_order(SEXP ip_addresses, bool decreasing = false) {
+
+  stats_call stats(STATS_IP_ORDER, Rf_xlength(ip_addresses));
+  std::vector < R_xlen_t > order = ip_sort_order(ip_addresses, decreasing, stats);
+  R_xlen_t input_size = (R_xlen_t) order.size();
+
+  // like order(), positions past INT_MAX need a double vector
+  if (input_size > INT_MAX) {
+    NumericVector output(input_size);
+    for (R_xlen_t i = 0; i < input_size; i++) {
+      output[i] = (double) order[i] + 1;
+    }
+    return output;
+  }
+  IntegerVector output(input_size);
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    output[i] = (int) order[i] + 1;
+  }
+  return output;
+}
+
+//' @rdname ip_order
+//' @export
+// [[Rcpp::export]]
+SEXP ip_sort(SEXP ip_addresses, bool decreasing = false) {
+
+  stats_call stats(STATS_IP_SORT, Rf_xlength(ip_addresses));
+  std::vector < R_xlen_t > order = ip_sort_order(ip_addresses, decreasing, stats);
+
+  if (is_packed_ip(ip_addresses) || is_ip_sequence(ip_addresses)) {
+    return packed_ip_subset(ip_addresses, order);
+  }
+  // the strings are shared with the input, not copied
+  R_xlen_t input_size = (R_xlen_t) order.size();
+  CharacterVector output(input_size);
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    SET_STRING_ELT(output, i, STRING_ELT(ip_addresses, order[i]));
+  }
+  return output;
+}
@@ -0,0 +1,79 @@
+#ifndef __IP_SORT__
+#define __IP_SORT__
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "cidr.h"
+
+/**
+ * An address key (uint32_t or uint128) and the position of the element it
+ * came from.
+ */
+template < typename Key >
+struct ip_sort_record {
+  Key key;
+  size_t index;
+};
+
+/**
+ * Byte b (0 being the least significant) of a key.
+ */
+static inline unsigned ip_sort_byte(uint32_t key, int b) {
+  return (key >> (8 * b)) & 0xff;
+}
+
+static inline unsigned ip_sort_byte(const uint128& key, int b) {
+  return (unsigned) ((b < 8 ? key.lo >> (8 * b) : key.hi >> (8 * (b - 8))) & 0xff);
+}
+
+/**
+ * Sort records by key with a least-significant-digit radix sort, a byte
+ * per pass. The sort is stable, so records with equal keys keep their
+ * relative order. The byte histograms for every pass are taken in one
+ * read of the input, and passes over a byte every key shares (the leading
+ * bytes of addresses from a few networks, say) are skipped.
+ */
+template < typename Key >
+void ip_radix_sort(std::vector < ip_sort_record < Key > >& records) {
+
+  const int bytes = sizeof(Key);
+  size_t n = records.size();
+
+  // below a few hundred records the histograms cost more than they save
+  if (n < 256) {
+    std::stable_sort(records.begin(), records.end(),
+                     [](const ip_sort_record < Key >& a, const ip_sort_record < Key >& b){
+      return a.key < b.key;
+    });
+    return;
+  }
+
+  std::vector < size_t > counts(256 * bytes, 0);
+  for (size_t i = 0; i < n; i++) {
+    for (int b = 0; b < bytes; b++) {
+      counts[256 * b + ip_sort_byte(records[i].key, b)]++;
+    }
+  }
+
+  std::vector < ip_sort_record < Key > > scratch(n);
+  for (int b = 0; b < bytes; b++) {
+    size_t* offset = &counts[256 * b];
+    if (offset[ip_sort_byte(records[0].key, b)] == n) {
+      continue;
+    }
+    size_t total = 0;
+    for (int digit = 0; digit < 256; digit++) {
+      size_t count = offset[digit];
+      offset[digit] = total;
+      total += count;
+    }
+    for (size_t i = 0; i < n; i++) {
+      scratch[offset[ip_sort_byte(records[i].key, b)]++] = records[i];
+    }
+    records.swap(scratch);
+  }
+}
+
+#endif
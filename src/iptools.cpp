@@ -13,34 +13,70 @@
 // #pragma clang diagnostic pop
 // #endif
 
-#include <bitset>
 
 #include "asio_bindings.h"
-#include <asio/ip/network_v4.hpp>
+#include "cidr.h"
+#include "ip_hash.h"
+#include "ip_parse.h"
+#include "packed_ip.h"
+#include "stats.h"
 
 using namespace Rcpp;
-using namespace asio::ip;
+
+/**
+ * Format a CIDR block ("10.0.0.0/8", "2001:db8::/32") as an R string.
+ */
+static SEXP format_cidr(const uint128& network, int prefix, int family){
+  char buf[50];
+  uint8_t bytes[16];
+  size_t len;
+  if (family == 4) {
+    len = format_ipv4((uint32_t) network.lo, buf);
+  } else {
+    network.to_bytes(bytes);
+    len = format_ipv6_compressed(bytes, buf);
+  }
+  buf[len++] = '/';
+  if (prefix >= 100) {
+    buf[len++] = '0' + prefix / 100;
+  }
+  if (prefix >= 10) {
+    buf[len++] = '0' + (prefix / 10) % 10;
+  }
+  buf[len++] = '0' + prefix % 10;
+  return Rf_mkCharLenCE(buf, len, CE_NATIVE);
+}
+
+/**
+ * The network mask of an IPv4 prefix of length prefix (0 to 32).
+ */
+static inline uint32_t subnet_mask_v4(int prefix){
+  return prefix <= 0 ? 0 : ~(uint32_t) 0 << (32 - prefix);
+}
 
 //[[Rcpp::export]]
 StringVector int_ip_to_subnet(StringVector ip_addresses, IntegerVector prefix_lengths) {
 
-  unsigned int input_size = ip_addresses.size();
-  asio::ip::address holding;
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ip_addresses.size();
+  bool recycle = prefix_lengths.size() == 1;
+  uint32_t ip;
   StringVector output(input_size);
+  stats_call stats(STATS_IP_TO_SUBNET, input_size);
+  R_xlen_t invalid = 0;
 
-  for(unsigned int i = 0; i < input_size; i++){
+  for(R_xlen_t i = 0; i < input_size; i++){
     if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
-    if (ip_addresses[i] == NA_STRING){
+    if (!ips.v4(i, &ip)){
       output[i] = NA_STRING;
+      invalid++;
     } else {
-      network_v4 net = network_v4(
-        address_v4::from_string(ip_addresses[i]),
-        prefix_lengths[i]
-      );
-      output[i] = net.network().to_string() + "/" + std::to_string(prefix_lengths[i]);
+      int prefix = prefix_lengths[recycle ? 0 : i];
+      SET_STRING_ELT(output, i, format_cidr(uint128(0, ip & subnet_mask_v4(prefix)), prefix, 4));
     }
   }
 
+  stats.invalid(invalid);
   return(output);
 
 }
@@ -48,6 +84,12 @@ StringVector int_ip_to_subnet(StringVector ip_addresses, IntegerVector prefix_le
 //' Convert a character vector of IPv6 addresses to a list of raw vectors of bytes
 //'
 //' @param input input IPv6 string vector
+//' @param matrix if \code{TRUE}, return a single 16 x \code{length(input)} raw
+//'        matrix (one address per column) rather than a list. Invalid addresses
+//'        get a column of zeros, so use \code{is_ipv6()} to tell them apart from
+//'        \code{"::"}.
+//' @return a list of 16-byte raw vectors (zero-length for invalid addresses) or,
+//'         with \code{matrix = TRUE}, a raw matrix.
 //' @export
 //' @examples
 //' c("2001:db8::1",
@@ -63,31 +105,382 @@ StringVector int_ip_to_subnet(StringVector ip_addresses, IntegerVector prefix_le
 //' ) -> tst6
 //'
 //' ipv6_to_bytes(tst6)
+//'
+//' ipv6_to_bytes(tst6, matrix = TRUE)
 //[[Rcpp::export]]
-List ipv6_to_bytes(std::vector < std::string > input) {
+SEXP ipv6_to_bytes(CharacterVector input, bool matrix = false) {
+
+  R_xlen_t input_size = input.size();
+  address_reader ips(input);
+  stats_call stats(STATS_IPV6_TO_BYTES, input_size);
+  R_xlen_t invalid = 0;
+
+  if (matrix) {
+    RawMatrix out(16, input_size);
+    uint8_t *bytes = RAW(out);
+    for (R_xlen_t i = 0; i < input_size; i++) {
+      if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+      if (!ips.v6(i, bytes + (size_t) i * 16)) {
+        memset(bytes + (size_t) i * 16, 0, 16);
+        invalid++;
+      }
+    }
+    stats.invalid(invalid);
+    return out;
+  }
 
-  List out = List(input.size());
+  List out = List(input_size);
+  uint8_t b[16];
 
-  for (unsigned int i=0; i<input.size(); i++) {
-    try{
-      asio::ip::address_v6::bytes_type b = asio::ip::make_address_v6(input[i].c_str()).to_bytes();
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+    if (ips.v6(i, b)) {
       RawVector v = RawVector(16);
-      for(unsigned int j=0; j<=15; j++) v[j] = b[j];
+      memcpy(RAW(v), b, 16);
       out[i] = v;
-    } catch(...) {
+    } else {
       out[i] = RawVector(0);
+      invalid++;
     }
   }
 
+  stats.invalid(invalid);
   return(out);
 
 }
 
-//' @title Convert a start+end IP address range pair to representative CIDR blocks
-//' @description takes in a single start/end pair and returns a charcter vector
-//'              of all the CIDR blocks necessary to contain the range.
-//' @param ip_start,ip_end range start/end (numeric)
-//' @return character vector
+/**
+ * Read element i of a range endpoint vector, which is either numeric (IPv4
+ * only) or a vector of IPv4/IPv6 addresses (in which case addresses is
+ * its reader).
+ *
+ * @return the endpoint's address family, or 0 if it is NA or invalid.
+ */
+static int range_endpoint(SEXP x, const address_reader* addresses, R_xlen_t i, uint128* out){
+  if (addresses) {
+    uint32_t v4;
+    uint8_t v6[16];
+    switch (addresses->family(i, &v4, v6)) {
+    case PACKED_V4:
+      *out = uint128(0, v4);
+      return 4;
+    case PACKED_V6:
+      *out = uint128::from_bytes(v6);
+      return 6;
+    default:
+      return 0;
+    }
+  }
+  double value;
+  if (TYPEOF(x) == INTSXP) {
+    value = INTEGER(x)[i] == NA_INTEGER ? NA_REAL : INTEGER(x)[i];
+  } else {
+    value = REAL(x)[i];
+  }
+  if (ISNAN(value) || value < 0 || value > 4294967295.0) {
+    return 0;
+  }
+  *out = uint128(0, (uint64_t) value);
+  return 4;
+}
+
+/**
+ * Decompose each (ip_start[i], ip_end[i]) pair into CIDR blocks, calling
+ * emit(i, network, prefix, family) for each block. Pairs with an invalid
+ * endpoint, mixed families or a start after their end produce no blocks.
+ */
+template < typename F >
+static void decompose_ranges(SEXP ip_start, SEXP ip_end, const stats_call& stats, F emit){
+  R_xlen_t input_size = Rf_xlength(ip_start);
+  if (Rf_xlength(ip_end) != input_size) {
+    throw std::range_error("ip_start and ip_end must be the same length");
+  }
+
+  std::unique_ptr < address_reader > starts, ends;
+  if (TYPEOF(ip_start) != REALSXP && TYPEOF(ip_start) != INTSXP) {
+    starts.reset(new address_reader(ip_start));
+  }
+  if (TYPEOF(ip_end) != REALSXP && TYPEOF(ip_end) != INTSXP) {
+    ends.reset(new address_reader(ip_end));
+  }
+
+  uint128 first, last;
+  R_xlen_t invalid = 0;
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+    int family = range_endpoint(ip_start, starts.get(), i, &first);
+    if (family == 0 || range_endpoint(ip_end, ends.get(), i, &last) != family || last < first) {
+      invalid++;
+      continue;
+    }
+    cidr_decompose(first, last, family, [&](const uint128& network, int prefix){
+      emit(i, network, prefix, family);
+    });
+  }
+  stats.invalid(invalid);
+}
+
+//[[Rcpp::export]]
+NumericVector int_ip_to_subnet_numeric(SEXP ip_addresses, IntegerVector prefix_lengths) {
+
+  R_xlen_t input_size = Rf_xlength(ip_addresses);
+  bool recycle = prefix_lengths.size() == 1;
+  uint128 ip;
+  NumericVector output(input_size);
+  stats_call stats(STATS_IP_TO_SUBNET, input_size);
+  R_xlen_t invalid = 0;
+
+  for(R_xlen_t i = 0; i < input_size; i++){
+    if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+    if (range_endpoint(ip_addresses, NULL, i, &ip) != 4){
+      output[i] = NA_REAL;
+      invalid++;
+    } else {
+      output[i] = (uint32_t) ip.lo & subnet_mask_v4(prefix_lengths[recycle ? 0 : i]);
+    }
+  }
+
+  stats.invalid(invalid);
+  return(output);
+
+}
+
+//' @title Count the IPv4 addresses in each subnet
+//' @description \code{subnet_counts} masks each IPv4 address to its
+//' \code{prefix_length} network and counts the addresses in each network, in a
+//' single hashing pass. It gives the same counts as
+//' \code{table(ip_to_subnet(ip_addresses, prefix_length))} without building a
+//' string per address.
+//'
+//' @param ip_addresses a vector of IPv4 addresses, either character (or packed,
+//'        see \code{\link{ip_pack}}) or numeric, as \code{\link{ip_to_numeric}}
+//'        returns. \code{NA}s, IPv6 addresses and anything else that isn't a valid
+//'        IPv4 address are skipped.
+//' @param prefix_length the length of the subnets' prefix, from 0 to 32; 24 (the
+//'        default) counts addresses per /24.
+//' @return a data.frame with one row per subnet that has at least one address,
+//'         in address order, and the columns "subnet" (the network in CIDR
+//'         notation), "network" (its numeric network address) and "count".
+//' @seealso \code{\link{ip_to_subnet}}
+//' @examples
+//' subnet_counts(c("192.168.1.1", "192.168.1.200", "10.1.1.1", "junk"))
+//'
+//' subnet_counts(ip_to_numeric(c("192.168.1.1", "192.168.2.1")), 16)
+//' @export
+//[[Rcpp::export]]
+DataFrame subnet_counts(SEXP ip_addresses, int prefix_length = 24) {
+
+  if (prefix_length == NA_INTEGER || prefix_length < 0 || prefix_length > 32) {
+    throw std::range_error("prefix_length must be between 0 and 32");
+  }
+
+  R_xlen_t input_size = Rf_xlength(ip_addresses);
+  stats_call stats(STATS_SUBNET_COUNTS, input_size);
+  std::unique_ptr < address_reader > ips;
+  if (TYPEOF(ip_addresses) != REALSXP && TYPEOF(ip_addresses) != INTSXP) {
+    ips.reset(new address_reader(ip_addresses));
+  }
+
+  uint32_t mask = subnet_mask_v4(prefix_length);
+  ip_hash_counter < uint32_t > subnets;
+  R_xlen_t invalid = 0;
+  uint32_t v4;
+  uint128 ip;
+
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+    if (ips ? ips->v4(i, &v4) : range_endpoint(ip_addresses, NULL, i, &ip) == 4) {
+      subnets.add((ips ? v4 : (uint32_t) ip.lo) & mask);
+    } else {
+      invalid++;
+    }
+  }
+  stats.invalid(invalid);
+
+  // there are usually far fewer subnets than addresses, so sorting them is cheap
+  std::vector < size_t > order(subnets.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  const std::vector < uint32_t >& networks = subnets.keys();
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b){
+    return networks[a] < networks[b];
+  });
+
+  CharacterVector subnet(order.size());
+  NumericVector network(order.size()), count(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    SET_STRING_ELT(subnet, i, format_cidr(uint128(0, networks[order[i]]), prefix_length, 4));
+    network[i] = networks[order[i]];
+    count[i] = (double) subnets.counts()[order[i]];
+  }
+
+  return DataFrame::create(_["subnet"] = subnet,
+                           _["network"] = network,
+                           _["count"] = count,
+                           _["stringsAsFactors"] = false);
+}
+
+/**
+ * The distinct valid addresses of a vector and how often each appears,
+ * with each family counted in its own hash table. first lists the distinct
+ * addresses in the order they first appeared, as their family and their
+ * index in that family's table.
+ */
+struct ip_tally {
+  ip_hash_counter < uint32_t > v4;
+  ip_hash_counter < uint128 > v6;
+  std::vector < std::pair < uint8_t, uint32_t > > first;
+};
+
+static void ip_tally_count(SEXP ip_addresses, ip_tally& tally, const stats_call& stats){
+  address_reader ips(ip_addresses);
+  R_xlen_t input_size = ips.size();
+  R_xlen_t invalid = 0;
+  uint32_t v4;
+  uint8_t v6[16];
+
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+    size_t seen, index;
+    switch (ips.family(i, &v4, v6)) {
+    case PACKED_V4:
+      seen = tally.v4.size();
+      index = tally.v4.add(v4);
+      if (tally.v4.size() != seen) {
+        tally.first.push_back(std::make_pair((uint8_t) PACKED_V4, (uint32_t) index));
+      }
+      break;
+    case PACKED_V6:
+      seen = tally.v6.size();
+      index = tally.v6.add(uint128::from_bytes(v6));
+      if (tally.v6.size() != seen) {
+        tally.first.push_back(std::make_pair((uint8_t) PACKED_V6, (uint32_t) index));
+      }
+      break;
+    default:
+      invalid++;
+    }
+  }
+  stats.invalid(invalid);
+}
+
+/**
+ * @return the distinct addresses tally.first[rows[i]] as a packed vector.
+ */
+static SEXP ip_tally_addresses(const ip_tally& tally, const std::vector < size_t >& rows){
+  packed_ip_builder out(rows.size(), tally.v6.size() > 0, PACKED_COMPRESSED, "");
+  uint8_t bytes[16];
+  for (size_t i = 0; i < rows.size(); i++) {
+    const std::pair < uint8_t, uint32_t >& address = tally.first[rows[i]];
+    if (address.first == PACKED_V4) {
+      out.set_v4(i, tally.v4.keys()[address.second]);
+    } else {
+      tally.v6.keys()[address.second].to_bytes(bytes);
+      out.set_v6(i, bytes);
+    }
+  }
+  return out.finish();
+}
+
+//' @title Count or deduplicate IP addresses
+//' @description \code{ip_count} counts how often each distinct IP address
+//' appears in a vector, and \code{ip_distinct} returns the distinct addresses.
+//' They do the job of \code{table()} and \code{unique()}, but parse each
+//' address once into a 32- or 128-bit key and count the keys in a hash table,
+//' so memory grows with the number of distinct addresses rather than with the
+//' input. Addresses are compared by value, so "2001:DB8::1" and
+//' "2001:db8:0:0:0:0:0:1" are the same address.
+//'
+//' @param ip_addresses a character (or packed, see \code{\link{ip_pack}}) vector
+//'        of IPv4 and/or IPv6 addresses. \code{NA}s and invalid addresses are
+//'        skipped.
+//' @param sort if \code{TRUE}, order the result by decreasing count (addresses
+//'        with the same count stay in the order they first appeared) rather than
+//'        by first appearance.
+//' @return for \code{ip_distinct}, a packed vector of the distinct addresses in
+//'         the order they first appear, with IPv6 addresses in compressed form;
+//'         for \code{ip_count}, a data.frame of those addresses ("address") and
+//'         the number of times each appears ("count").
+//' @seealso \code{\link{subnet_counts}} to count addresses per subnet.
+//' @examples
+//' ips <- c("10.0.0.1", "2001:db8::1", "10.0.0.2", "10.0.0.1", "2001:DB8:0::1", "junk")
+//' ip_distinct(ips)
+//' ip_count(ips)
+//' ip_count(ips, sort = TRUE)
+//' @export
+//[[Rcpp::export]]
+DataFrame ip_count(SEXP ip_addresses, bool sort = false) {
+
+  stats_call stats(STATS_IP_COUNT, Rf_xlength(ip_addresses));
+  ip_tally tally;
+  ip_tally_count(ip_addresses, tally, stats);
+
+  std::vector < size_t > rows(tally.first.size());
+  NumericVector count(rows.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = i;
+  }
+  auto count_of = [&](size_t row){
+    const std::pair < uint8_t, uint32_t >& address = tally.first[row];
+    return address.first == PACKED_V4 ? tally.v4.counts()[address.second] : tally.v6.counts()[address.second];
+  };
+  if (sort) {
+    std::stable_sort(rows.begin(), rows.end(), [&](size_t a, size_t b){
+      return count_of(a) > count_of(b);
+    });
+  }
+  for (size_t i = 0; i < rows.size(); i++) {
+    count[i] = (double) count_of(rows[i]);
+  }
+
+  return DataFrame::create(_["address"] = ip_tally_addresses(tally, rows),
+                           _["count"] = count,
+                           _["stringsAsFactors"] = false);
+}
+
+//' @rdname ip_count
+//' @export
+//[[Rcpp::export]]
+SEXP ip_distinct(SEXP ip_addresses) {
+
+  stats_call stats(STATS_IP_DISTINCT, Rf_xlength(ip_addresses));
+  ip_tally tally;
+  ip_tally_count(ip_addresses, tally, stats);
+
+  std::vector < size_t > rows(tally.first.size());
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = i;
+  }
+  return ip_tally_addresses(tally, rows);
+}
+
+//' @title Convert start+end IP address range pairs to representative CIDR blocks
+//' @description \code{range_boundaries_to_cidr} takes vectors of range start and end
+//' addresses and returns a character vector of all the CIDR blocks necessary to
+//' contain the ranges. \code{cidr_decompose} does the same, but returns a
+//' data.frame with one row per block, so blocks can be traced back to their range.
+//'
+//' @param ip_start,ip_end range starts/ends, either numeric (IPv4 only) or as
+//' IPv4 or IPv6 addresses. Ranges with an invalid or \code{NA} endpoint, a start
+//' and end of different families, or a start after their end produce no blocks.
+//'
+//' @return for \code{range_boundaries_to_cidr}, a character vector of CIDR blocks,
+//' in the order of the ranges. For \code{cidr_decompose}, a data.frame of four columns:
+//' "range_id" (the position of the block's range in \code{ip_start}), "network" (the
+//' block's network address), "network_numeric" (the same as a number, or \code{NA}
+//' for IPv6 blocks, which are too large to represent exactly) and "prefix" (the
+//' block's prefix length).
+//'
+//' @details Each range is decomposed iteratively, growing each block for as long as it
+//' stays aligned and inside the range, so long ranges and IPv6 ranges cost at most one
+//' block per bit of address.
 //' @export
 //' @examples
 //' range_boundaries_to_cidr(
@@ -95,40 +488,235 @@ List ipv6_to_bytes(std::vector < std::string > input) {
 //'  ip_to_numeric("192.100.179.255")
 //' )
 //' ## [1] "192.100.176.0/22"
+//'
+//' cidr_decompose(c("10.0.0.0", "2001:db8::"), c("10.0.0.2", "2001:db8::ffff"))
+//' ##   range_id      network network_numeric prefix
+//' ## 1        1     10.0.0.0       167772160     31
+//' ## 2        1     10.0.0.2       167772162     32
+//' ## 3        2   2001:db8::              NA    112
 //[[Rcpp::export]]
-std::vector < std::string > range_boundaries_to_cidr(long int ip_start, long int ip_end) {
-
-  uint8_t bits = 1;
-  long int mask = 1;
-  long int new_ip;
-  std::stringstream ss;
-  std::vector < std::string > cidrs;
-
-  while (bits < 32) {
-    new_ip = ip_start | mask;
-    if ((new_ip > ip_end) || (((ip_start >> bits) << bits) != ip_start)) {
-      bits--;
-      mask = mask >> 1;
-      break;
+CharacterVector range_boundaries_to_cidr(SEXP ip_start, SEXP ip_end) {
+
+  std::vector < uint128 > networks;
+  std::vector < int > prefixes;
+  std::vector < unsigned char > families;
+  stats_call stats(STATS_RANGE_BOUNDARIES_TO_CIDR, Rf_xlength(ip_start));
+
+  decompose_ranges(ip_start, ip_end, stats, [&](R_xlen_t, const uint128& network, int prefix, int family){
+    networks.push_back(network);
+    prefixes.push_back(prefix);
+    families.push_back(family);
+  });
+
+  CharacterVector output(networks.size());
+  for (size_t i = 0; i < networks.size(); i++) {
+    SET_STRING_ELT(output, i, format_cidr(networks[i], prefixes[i], families[i]));
+  }
+
+  return output;
+}
+
+//' @rdname range_boundaries_to_cidr
+//' @export
+//[[Rcpp::export]]
+DataFrame cidr_decompose(SEXP ip_start, SEXP ip_end) {
+
+  std::vector < int > range_ids;
+  std::vector < uint128 > networks;
+  std::vector < int > prefixes;
+  std::vector < unsigned char > families;
+  bool any_v6 = false;
+  stats_call stats(STATS_CIDR_DECOMPOSE, Rf_xlength(ip_start));
+
+  decompose_ranges(ip_start, ip_end, stats, [&](R_xlen_t i, const uint128& network, int prefix, int family){
+    range_ids.push_back(i + 1);
+    networks.push_back(network);
+    prefixes.push_back(prefix);
+    families.push_back(family);
+    any_v6 = any_v6 || family == 6;
+  });
+
+  R_xlen_t output_size = networks.size();
+  packed_ip_builder network(output_size, any_v6, PACKED_COMPRESSED, "");
+  NumericVector network_numeric(output_size);
+  uint8_t bytes[16];
+  for (R_xlen_t i = 0; i < output_size; i++) {
+    if (families[i] == 4) {
+      network.set_v4(i, (uint32_t) networks[i].lo);
+      network_numeric[i] = (double) networks[i].lo;
+    } else {
+      networks[i].to_bytes(bytes);
+      network.set_v6(i, bytes);
+      network_numeric[i] = NA_REAL;
     }
-    bits++;
-    mask = (mask << 1) + 1;
   }
 
-  new_ip = ip_start | mask;
-  bits = 32 - bits;
+  return DataFrame::create(_["range_id"] = IntegerVector(range_ids.begin(), range_ids.end()),
+                           _["network"] = network.finish(),
+                           _["network_numeric"] = network_numeric,
+                           _["prefix"] = IntegerVector(prefixes.begin(), prefixes.end()),
+                           _["stringsAsFactors"] = false);
+}
+
+typedef std::vector < std::pair < uint128, uint128 > > cidr_set;
+
+/**
+ * Parse a vector of CIDR blocks into sorted, disjoint IPv4 and IPv6
+ * intervals. Bare addresses are blocks of one, host bits are masked off,
+ * and NA or invalid entries are dropped.
+ */
+static void cidr_set_parse(const CharacterVector& cidrs, cidr_set& v4, cidr_set& v6, const stats_call& stats){
 
-  // get the first (possibly only) CIDR block
-  ss << ((long int)bits);
-  cidrs.push_back(asio::ip::address_v4(ip_start).to_string() + "/" + ss.str());
+  uint128 address;
+  int prefix;
+  R_xlen_t invalid = 0;
 
-  if (new_ip < ip_end) { // if we're not done, compute more and join everything together
-    std::vector < std::string > tmp_cidrs = range_boundaries_to_cidr(new_ip+1, ip_end);
-    cidrs.insert(cidrs.end(), tmp_cidrs.begin(), tmp_cidrs.end());
+  v4.clear();
+  v6.clear();
+  for (R_xlen_t i = 0; i < cidrs.size(); i++) {
+    if ((i % 10000) == 0) {
+      Rcpp::checkUserInterrupt();
+    }
+    SEXP cidr = STRING_ELT(cidrs, i);
+    if (cidr == NA_STRING) {
+      invalid++;
+      continue;
+    }
+    int family = cidr_parse(CHAR(cidr), LENGTH(cidr), &address, &prefix);
+    if (!family) {
+      family = cidr_parse_address(CHAR(cidr), LENGTH(cidr), &address);
+      prefix = cidr_bits(family);
+    }
+    if (!family || prefix < 0 || prefix > cidr_bits(family)) {
+      invalid++;
+      continue;
+    }
+    uint128 network = address & cidr_net_mask(family, prefix);
+    (family == 4 ? v4 : v6).push_back(std::make_pair(network, network | cidr_host_mask(family, prefix)));
+  }
+  stats.invalid(invalid);
+
+  cidr_merge(v4);
+  cidr_merge(v6);
+}
+
+/**
+ * Split sorted, disjoint IPv4 and IPv6 intervals into the fewest CIDR
+ * blocks, IPv4 first.
+ */
+static CharacterVector cidr_set_format(const cidr_set& v4, const cidr_set& v6){
+
+  std::vector < uint128 > networks;
+  std::vector < int > prefixes;
+  std::vector < unsigned char > families;
+  for (int family = 4; family <= 6; family += 2) {
+    const cidr_set& blocks = family == 4 ? v4 : v6;
+    for (size_t i = 0; i < blocks.size(); i++) {
+      cidr_decompose(blocks[i].first, blocks[i].second, family, [&](const uint128& network, int prefix){
+        networks.push_back(network);
+        prefixes.push_back(prefix);
+        families.push_back(family);
+      });
+    }
+  }
+
+  CharacterVector output(networks.size());
+  for (size_t i = 0; i < networks.size(); i++) {
+    SET_STRING_ELT(output, i, format_cidr(networks[i], prefixes[i], families[i]));
   }
 
-  return(cidrs);
+  return output;
+}
+
+//' @title Collapse a set of CIDR blocks into the fewest equivalent blocks
+//' @description \code{cidr_collapse} takes a vector of IPv4 and IPv6 CIDR blocks,
+//' such as a blocklist gathered from several feeds, and returns the smallest set of
+//' blocks covering exactly the same addresses: blocks inside other blocks are
+//' dropped, and overlapping or adjacent blocks are merged.
+//'
+//' @param cidrs a vector of CIDR blocks. Bare addresses are treated as blocks of one,
+//' host bits are ignored ("10.0.0.1/8" is "10.0.0.0/8"), and \code{NA} or invalid
+//' entries are dropped.
+//'
+//' @return a character vector of CIDR blocks, the IPv4 ones first, each in address order.
+//'
+//' @details The blocks are sorted and merged into disjoint intervals, which are then
+//' split back into CIDR blocks the same way as in \code{\link{range_boundaries_to_cidr}},
+//' so the whole operation is O(n log n).
+//' @seealso \code{\link{cidr_union}} and friends for set operations on CIDR lists.
+//' @export
+//' @examples
+//' cidr_collapse(c("10.0.0.0/24", "10.0.1.0/24", "10.0.0.128/25", "2001:db8::/33",
+//'                 "2001:db8:8000::/33", "192.168.1.1"))
+//' ## [1] "10.0.0.0/23"     "192.168.1.1/32"  "2001:db8::/32"
+//[[Rcpp::export]]
+CharacterVector cidr_collapse(CharacterVector cidrs) {
+  stats_call stats(STATS_CIDR_COLLAPSE, cidrs.size());
+  cidr_set v4, v6;
+  cidr_set_parse(cidrs, v4, v6, stats);
+  return cidr_set_format(v4, v6);
+}
+
+//' @title Set operations on CIDR lists
+//' @description \code{cidr_union}, \code{cidr_intersect} and \code{cidr_setdiff}
+//' treat two vectors of IPv4 and IPv6 CIDR blocks as the sets of addresses they
+//' cover, and return the addresses in either, in both, or in \code{x} but not
+//' \code{y}, as the fewest CIDR blocks.
+//'
+//' @param x,y vectors of CIDR blocks, read as by \code{\link{cidr_collapse}}.
+//'
+//' @return a character vector of CIDR blocks, the IPv4 ones first, each in address order.
+//'
+//' @details Each list is sorted and merged into disjoint intervals, and the
+//' operation is a single pass over both, so the cost depends on the number of
+//' blocks, never on the number of addresses they cover.
+//' @export
+//' @examples
+//' allocated <- c("10.0.0.0/16", "2001:db8::/32")
+//' allowlist <- c("10.0.1.0/24", "10.0.128.0/17", "2001:db8::/33")
+//' cidr_setdiff(allocated, allowlist)
+//' ## [1] "10.0.0.0/24"        "10.0.2.0/23"        "10.0.4.0/22"
+//' ## [4] "10.0.8.0/21"        "10.0.16.0/20"       "10.0.32.0/19"
+//' ## [7] "10.0.64.0/18"       "2001:db8:8000::/33"
+//' cidr_intersect(allocated, allowlist)
+//' cidr_union(allocated, allowlist)
+//[[Rcpp::export]]
+CharacterVector cidr_union(CharacterVector x, CharacterVector y) {
+  stats_call stats(STATS_CIDR_UNION, x.size() + y.size());
+  cidr_set x4, x6, y4, y6;
+  cidr_set_parse(x, x4, x6, stats);
+  cidr_set_parse(y, y4, y6, stats);
+  x4.insert(x4.end(), y4.begin(), y4.end());
+  x6.insert(x6.end(), y6.begin(), y6.end());
+  cidr_merge(x4);
+  cidr_merge(x6);
+  return cidr_set_format(x4, x6);
+}
+
+//' @rdname cidr_union
+//' @export
+//[[Rcpp::export]]
+CharacterVector cidr_intersect(CharacterVector x, CharacterVector y) {
+  stats_call stats(STATS_CIDR_INTERSECT, x.size() + y.size());
+  cidr_set x4, x6, y4, y6, out4, out6;
+  cidr_set_parse(x, x4, x6, stats);
+  cidr_set_parse(y, y4, y6, stats);
+  cidr_intersect_intervals(x4, y4, out4);
+  cidr_intersect_intervals(x6, y6, out6);
+  return cidr_set_format(out4, out6);
+}
 
+//' @rdname cidr_union
+//' @export
+//[[Rcpp::export]]
+CharacterVector cidr_setdiff(CharacterVector x, CharacterVector y) {
+  stats_call stats(STATS_CIDR_SETDIFF, x.size() + y.size());
+  cidr_set x4, x6, y4, y6, out4, out6;
+  cidr_set_parse(x, x4, x6, stats);
+  cidr_set_parse(y, y4, y6, stats);
+  cidr_subtract_intervals(x4, y4, out4);
+  cidr_subtract_intervals(x6, y6, out6);
+  return cidr_set_format(out4, out6);
 }
 
 //' @title Returns the IP addresses associated with a hostname.
@@ -196,6 +784,61 @@ std::list < std::vector < std::string > > ip_to_hostname(std::vector < std::stri
   return asio_inst.multi_ip_to_dns(ip_addresses);
 }
 
+//' @title Resolve many hostnames or IP addresses concurrently
+//' @description \code{hostname_to_ip_async} and \code{ip_to_hostname_async} are
+//' versions of \code{\link{hostname_to_ip}} and \code{\link{ip_to_hostname}} that
+//' keep several lookups in flight at once, rather than waiting for each one
+//' to finish before starting the next, and give up on any single lookup after
+//' \code{timeout} seconds.
+//'
+//' @param hostnames a vector of hostnames.
+//'
+//' @param ip_addresses a vector of IPv4 or IPv6 addresses.
+//'
+//' @param concurrency the maximum number of lookups in flight at once.
+//'
+//' @param timeout how long, in seconds, to wait for any one lookup.
+//'
+//' @return a data.frame with one row per answer, containing \code{query_id} (the
+//' index of the query in the input), \code{query}, \code{answer} and \code{status}.
+//' Queries without an answer get a single row with an \code{NA} answer and a status
+//' of "not_resolved", "timeout" or "invalid" (for \code{NA}s, and for
+//' \code{ip_to_hostname_async}, strings that aren't IP addresses); the rest have a
+//' status of "ok".
+//'
+//' @details Lookups go through the system resolver, which can't be interrupted
+//' part-way through. A lookup that times out is reported as "timeout" straight
+//' away and the call carries on without it; the abandoned lookup runs on in a
+//' background thread until the resolver gives up on it, so each one ties up a
+//' thread (not the R session) for up to the resolver's own timeout. Each
+//' in-flight lookup has its own resolver thread, so \code{concurrency} is also
+//' the number of resolver threads started.
+//'
+//' @seealso \code{\link{hostname_to_ip}} and \code{\link{ip_to_hostname}} for the
+//' one-at-a-time versions.
+//'
+//' @examples
+//' \dontrun{
+//' hostname_to_ip_async(c("dds.ec", "ironholds.org"), concurrency = 2)
+//'
+//' ip_to_hostname_async("162.243.111.4", timeout = 1)
+//' }
+//' @rdname async_dns
+//' @export
+//[[Rcpp::export]]
+DataFrame hostname_to_ip_async(CharacterVector hostnames, int concurrency = 32, double timeout = 5){
+  asio_bindings asio_inst;
+  return asio_inst.async_hostname_to_dns(hostnames, concurrency, timeout);
+}
+
+//' @rdname async_dns
+//' @export
+//[[Rcpp::export]]
+DataFrame ip_to_hostname_async(CharacterVector ip_addresses, int concurrency = 32, double timeout = 5){
+  asio_bindings asio_inst;
+  return asio_inst.async_ip_to_dns(ip_addresses, concurrency, timeout);
+}
+
 //' @title convert between numeric and dotted-decimal IPv4 forms.
 //' @description \code{ip_to_numeric} takes IP addresses stored
 //' in their human-readable representation ("192.168.0.1")
@@ -212,8 +855,8 @@ std::list < std::vector < std::string > > ip_to_hostname(std::vector < std::stri
 //' at all) the returned value for that IP will be 0.
 //'
 //' For \code{numeric_to_ip}: a vector containing the dotted-decimal representation of \code{ip_addresses},
-//' as character strings. If a value cannot be resolved to an IPv4 address, it will appear as "0.0.0.0" or
-//' an empty string.
+//' as a packed character vector (see \code{\link{ip_pack}}). \code{NA}s stay \code{NA}, and values outside
+//' the IPv4 space appear as "0.0.0.0".
 //'
 //' @examples
 //' #Convert your local, internal IP to its numeric representation.
@@ -226,7 +869,7 @@ std::list < std::vector < std::string > > ip_to_hostname(std::vector < std::stri
 //' @rdname ip_numeric
 //' @export
 // [[Rcpp::export]]
-std::vector < unsigned int > ip_to_numeric(std::vector < std::string > ip_addresses){
+NumericVector ip_to_numeric(CharacterVector ip_addresses){
   asio_bindings asio_inst;
   return asio_inst.ip_to_numeric_(ip_addresses);
 }
@@ -238,7 +881,7 @@ std::vector < unsigned int > ip_to_numeric(std::vector < std::string > ip_addres
 //' @return a numeric vector of scopes
 //' @export
 // [[Rcpp::export]]
-std::vector < unsigned long > v6_scope(std::vector < std::string > ip_addresses){
+NumericVector v6_scope(CharacterVector ip_addresses){
   asio_bindings asio_inst;
   return asio_inst.v6_scope_(ip_addresses);
 }
@@ -246,10 +889,11 @@ std::vector < unsigned long > v6_scope(std::vector < std::string > ip_addresses)
 //' Expand an IPv6 address from an abbreviated version
 //'
 //' @param ip_addresses a vector of IPv6 IP addresses.
-//' @return a character vector of expanded IPv6 addresses
+//' @return a packed character vector (see \code{\link{ip_pack}}) of expanded IPv6
+//' addresses; anything that isn't an IPv6 address becomes an empty string.
 //' @export
 // [[Rcpp::export]]
-std::vector < std::string > expand_ipv6(std::vector < std::string > ip_addresses){
+SEXP expand_ipv6(CharacterVector ip_addresses){
   asio_bindings asio_inst;
   return asio_inst.expand_ipv6_(ip_addresses);
 }
@@ -257,7 +901,7 @@ std::vector < std::string > expand_ipv6(std::vector < std::string > ip_addresses
 //' @rdname ip_numeric
 //' @export
 // [[Rcpp::export]]
-std::vector < std::string > numeric_to_ip (std::vector < unsigned int > ip_addresses){
+SEXP numeric_to_ip (NumericVector ip_addresses){
   asio_bindings asio_inst;
   return asio_inst.numeric_to_ip_(ip_addresses);
 }
@@ -302,14 +946,16 @@ CharacterVector ip_classify(CharacterVector ip_addresses){
 //' ("172.18.0.0/28"), \code{range_boundaries} calculates the
 //' maximum and minimum IP addresses in that range.
 //'
-//' @param ranges a vector of IP ranges. Currently only IPv4 ranges
-//' work.
+//' @param ranges a vector of IPv4 or IPv6 ranges ("2001:db8::/32").
 //'
 //' @return a data.frame of four columns, "minimum_ip" (containing the
 //' smallest IP in the provided range) and "maximum_ip" (containing the
 //' largest). "min_numeric" & "max_numeric" (the min & max numeric versions
 //' of "minimum_ip" and "maximum_ip") and the original range string.
-//' If the range was invalid, both columns will contain Invalid" as the value.
+//' If the range was invalid, both columns will contain "Invalid" as the value.
+//' The IP columns are packed address vectors (see \code{\link{ip_pack}}); since
+//' IPv6 addresses are too large to represent exactly as numbers, the numeric
+//' columns are \code{NA} for IPv6 ranges.
 //'
 //' @examples
 //' range_boundaries("172.18.0.0/28")
@@ -323,7 +969,7 @@ CharacterVector ip_classify(CharacterVector ip_addresses){
 //'
 //' @export
 // [[Rcpp::export]]
-DataFrame range_boundaries(std::vector < std::string > ranges){
+DataFrame range_boundaries(CharacterVector ranges){
   asio_bindings asio_inst;
   return asio_inst.calculate_range_(ranges);
 }
@@ -353,9 +999,13 @@ DataFrame range_boundaries(std::vector < std::string > ranges){
 //'ip_in_range("172.18.0.1","172.18.0.0/28")
 //'#[1] TRUE
 //'
+//'#IPv6 ranges work too; an IPv4 address is never in an IPv6 range
+//'ip_in_range(c("2001:db8::1", "192.168.0.1"), "2001:db8::/32")
+//'#[1]  TRUE FALSE
+//'
 //'@export
 //[[Rcpp::export]]
-std::vector < bool > ip_in_range(std::vector < std::string > ip_addresses, std::vector < std::string > ranges){
+LogicalVector ip_in_range(CharacterVector ip_addresses, CharacterVector ranges){
   asio_bindings asio_inst;
   return asio_inst.ip_in_range_(ip_addresses, ranges);
 }
@@ -366,7 +1016,13 @@ std::vector < bool > ip_in_range(std::vector < std::string > ip_addresses, std::
 //'
 //'@param ip_addresses character vector of IP addresses
 //'@param ranges character vector of CIDR reanges
-//'@return a logical vector of whether a given IP was in any of the ranges
+//'@return a logical vector of whether a given IP was in any of the ranges. Invalid
+//'IP addresses are never in range, and invalid ranges are ignored.
+//'@details The ranges are merged into a sorted set of non-overlapping intervals
+//'once per call, so each IP is checked with a binary search rather than against
+//'every range. Input that is already sorted is matched in a single merge pass.
+//'IPv4 and IPv6 ranges can be mixed; each address is only checked against the
+//'ranges of its own family.
 //'@examples \dontrun{
 //' north_america <- unlist(country_ranges(countries=c("US", "CA", "MX")))
 //' germany <- unlist(country_ranges("DE"))
@@ -393,16 +1049,17 @@ std::vector < bool > ip_in_range(std::vector < std::string > ip_addresses, std::
 //'}
 //'@export
 //[[Rcpp::export]]
-std::vector < bool > ip_in_any(std::vector < std::string > ip_addresses, std::vector < std::string > ranges){
+LogicalVector ip_in_any(CharacterVector ip_addresses, CharacterVector ranges){
   asio_bindings asio_inst;
   return asio_inst.ip_in_any_(ip_addresses, ranges);
 }
 
-//'@title check whether IPv4 ranges are valid
+//'@title check whether IP ranges are valid
 //'@description \code{validate_range} checks whether
-//'a vector of IPv4 CIDR ranges ("127.0.0.1/32") are valid or not.
+//'a vector of IPv4 or IPv6 CIDR ranges ("127.0.0.1/32", "2001:db8::/32") are
+//'valid or not.
 //'
-//'@param ranges a vector of IPv4 ranges
+//'@param ranges a vector of IPv4 or IPv6 ranges
 //'
 //'@return a logical vector, where TRUE indicates that the
 //'provided entry is valid, and FALSE that it is not (or
@@ -418,10 +1075,12 @@ std::vector < bool > ip_in_any(std::vector < std::string > ip_addresses, std::ve
 //'#[1] TRUE
 //'validate_range("127.0.0.1/33")
 //'#[1] FALSE
+//'validate_range("2001:db8::/129")
+//'#[1] FALSE
 //'
 //' @export
 //[[Rcpp::export]]
-std::vector < bool > validate_range(std::vector < std::string > ranges){
+LogicalVector validate_range(CharacterVector ranges){
   asio_bindings asio_inst;
   return asio_inst.validate_range_(ranges);
 }
@@ -437,18 +1096,35 @@ std::vector < bool > validate_range(std::vector < std::string > ranges){
 //'@param x_forwarded_for an equally-sized vector of X-Forwarded-For header
 //'contents.
 //'
+//'@param trusted_proxies an optional vector of CIDR ranges (IPv4 or IPv6) covering
+//'your own proxies and load balancers. See Details.
+//'
 //'@return a vector of IP addresses, incorporating the XFF header value
 //'where appropriate.
 //'
+//'@details Without \code{trusted_proxies}, the left-most valid IP address in the
+//'header is used. Since clients can send any header they like, that is only safe
+//'when the header is known to be clean. With \code{trusted_proxies}, the header
+//'is only used when the request came from a trusted proxy, and is read from right
+//'to left: the first address that isn't a trusted proxy is the client (or, if every
+//'hop is trusted, the left-most one). Whitespace around hops is ignored, and
+//'entries that aren't IP addresses (such as "unknown") are skipped.
+//'
 //'@examples
 //'xff_extract("192.168.0.1", "193.168.0.1, 230.98.107.1")
 //'
+//'# a spoofed left-most hop is ignored when the proxies are known
+//'xff_extract("10.0.0.2", "1.2.3.4, 230.98.107.1, 10.0.0.1",
+//'            trusted_proxies = "10.0.0.0/8")
+//'#[1] "230.98.107.1"
+//'
 //'@export
 // [[Rcpp::export]]
-std::vector < std::string > xff_extract(std::vector < std::string > ip_addresses,
-                                          std::vector < std::string > x_forwarded_for){
+CharacterVector xff_extract(CharacterVector ip_addresses,
+                            CharacterVector x_forwarded_for,
+                            CharacterVector trusted_proxies = CharacterVector::create()){
   asio_bindings asio_inst;
-  return asio_inst.xff_normalise(ip_addresses, x_forwarded_for);
+  return asio_inst.xff_normalise(ip_addresses, x_forwarded_for, trusted_proxies);
 }
 
 //'@title Logical checks for IP addresses
@@ -488,19 +1164,30 @@ LogicalVector is_multicast(CharacterVector ip_addresses){
 //' @param input numeric vector of IP addresses
 //' @export
 // [[Rcpp::export]]
-CharacterVector ip_numeric_to_binary_string(std::vector < unsigned int > input) {
+CharacterVector ip_numeric_to_binary_string(NumericVector input) {
 
-  std::vector<std::string> output(input.size());
+  R_xlen_t input_size = input.size();
+  CharacterVector output(input_size);
+  stats_call stats(STATS_IP_NUMERIC_TO_BINARY_STRING, input_size);
+  R_xlen_t invalid = 0;
+  char bits[32];
 
-  for (unsigned int i=0; i<input.size(); i++){
+  for (R_xlen_t i = 0; i < input_size; i++){
 
     if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
 
-    output[i] = std::bitset<32>(input[i]).to_string();
+    uint32_t ip = 0;
+    if (input[i] >= 0 && input[i] <= 4294967295.0) {
+      ip = (uint32_t) input[i];
+    } else {
+      invalid++;
+    }
+    SET_STRING_ELT(output, i, Rf_mkCharLenCE(bits, format_binary_string(ip, bits), CE_NATIVE));
 
   }
 
-  return(Rcpp::wrap(output));
+  stats.invalid(invalid);
+  return(output);
 }
 
 //' Convert a numeric vector of IPv4 addresses to a character vector of
@@ -509,20 +1196,28 @@ CharacterVector ip_numeric_to_binary_string(std::vector < unsigned int > input)
 //' @param input character vector of IP addresses
 //' @export
 // [[Rcpp::export]]
-CharacterVector ip_to_binary_string(std::vector < std::string > input) {
-
-  asio_bindings asio_inst;
+CharacterVector ip_to_binary_string(CharacterVector input) {
 
-  std::vector<std::string> output(input.size());
-  std::vector<unsigned int> x = asio_inst.ip_to_numeric_(input);
+  R_xlen_t input_size = input.size();
+  CharacterVector output(input_size);
+  address_reader ips(input);
+  stats_call stats(STATS_IP_TO_BINARY_STRING, input_size);
+  R_xlen_t invalid = 0;
+  char bits[32];
 
-  for (unsigned int i=0; i<input.size(); i++){
+  for (R_xlen_t i = 0; i < input_size; i++){
 
     if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
 
-    output[i] = std::bitset<32>(x[i]).to_string();
+    uint32_t ip = 0;
+    if (!ips.v4(i, &ip)) {
+      ip = 0;
+      invalid++;
+    }
+    SET_STRING_ELT(output, i, Rf_mkCharLenCE(bits, format_binary_string(ip, bits), CE_NATIVE));
 
   }
 
-  return(Rcpp::wrap(output));
+  stats.invalid(invalid);
+  return(output);
 }
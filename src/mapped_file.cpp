@@ -0,0 +1,86 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::string& path){
+  close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  // the mapping keeps the file open
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return false;
+  }
+  const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == NULL) {
+    CloseHandle(mapping);
+    return false;
+  }
+  address = (const char*) view;
+  length = (size_t) file_size.QuadPart;
+  handle = mapping;
+  return true;
+}
+
+void mapped_file::close(){
+  if (address != NULL) {
+    UnmapViewOfFile(address);
+    CloseHandle((HANDLE) handle);
+  }
+  address = NULL;
+  length = 0;
+  handle = NULL;
+}
+
+#else
+
+bool mapped_file::open(const std::string& path){
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* view = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping keeps the file open
+  ::close(fd);
+  if (view == MAP_FAILED) {
+    return false;
+  }
+  address = (const char*) view;
+  length = (size_t) info.st_size;
+  return true;
+}
+
+void mapped_file::close(){
+  if (address != NULL) {
+    munmap((void*) address, length);
+  }
+  address = NULL;
+  length = 0;
+  handle = NULL;
+}
+
+#endif
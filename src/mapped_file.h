@@ -0,0 +1,48 @@
+#ifndef __MAPPED_FILE__
+#define __MAPPED_FILE__
+
+#include <stddef.h>
+#include <string>
+
+/**
+ * A file mapped read-only into memory. The pages are shared with every
+ * other process mapping the same file, and are only read from disk when
+ * touched.
+ */
+class mapped_file {
+
+public:
+
+  mapped_file() : address(NULL), length(0), handle(NULL) {}
+
+  ~mapped_file(){
+    close();
+  }
+
+  /**
+   * Map a file, replacing any existing mapping.
+   *
+   * @return false if the file couldn't be opened or mapped (or is empty).
+   */
+  bool open(const std::string& path);
+
+  void close();
+
+  const char* data() const {
+    return address;
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+private:
+  const char* address;
+  size_t length;
+  void* handle;
+
+  mapped_file(const mapped_file&);
+  mapped_file& operator=(const mapped_file&);
+};
+
+#endif
@@ -0,0 +1,483 @@
+#include <Rcpp.h>
+#include <R_ext/Altrep.h>
+
+#include "ip_parse.h"
+#include "packed_ip.h"
+
+using namespace Rcpp;
+
+static R_altrep_class_t packed_ip_class;
+static R_altrep_class_t ip_sequence_class;
+
+enum {PACKED_STORAGE = 0, PACKED_FAMILIES, PACKED_STYLE, PACKED_INVALID_STR};
+enum {SEQUENCE_START = 0, SEQUENCE_FAMILY, SEQUENCE_LENGTH};
+
+bool is_packed_ip(SEXP x){
+  return ALTREP(x) && R_altrep_inherits(x, packed_ip_class) && R_altrep_data2(x) == R_NilValue;
+}
+
+static int packed_family_of(SEXP data1, R_xlen_t i){
+  SEXP families = VECTOR_ELT(data1, PACKED_FAMILIES);
+  if (families != R_NilValue) {
+    return RAW(families)[i];
+  }
+  return TYPEOF(VECTOR_ELT(data1, PACKED_STORAGE)) == INTSXP ? PACKED_V4 : PACKED_V6;
+}
+
+static R_xlen_t packed_length(SEXP x){
+  SEXP data1 = R_altrep_data1(x);
+  SEXP storage = VECTOR_ELT(data1, PACKED_STORAGE);
+  return TYPEOF(storage) == INTSXP ? XLENGTH(storage) : XLENGTH(storage) / 16;
+}
+
+/**
+ * Format element i of a packed vector as a CHARSXP.
+ */
+static SEXP packed_format(SEXP data1, R_xlen_t i){
+  SEXP storage = VECTOR_ELT(data1, PACKED_STORAGE);
+  char str[46];
+  size_t len;
+
+  switch (packed_family_of(data1, i)) {
+  case PACKED_NA:
+    return NA_STRING;
+  case PACKED_INVALID:
+    return STRING_ELT(VECTOR_ELT(data1, PACKED_INVALID_STR), 0);
+  case PACKED_V4:
+    if (TYPEOF(storage) == INTSXP) {
+      len = format_ipv4((uint32_t) INTEGER(storage)[i], str);
+    } else {
+      const uint8_t *b = RAW(storage) + 16 * i;
+      len = format_ipv4(((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) |
+                        ((uint32_t) b[2] << 8) | b[3], str);
+    }
+    break;
+  default:
+    if (INTEGER(VECTOR_ELT(data1, PACKED_STYLE))[0] == PACKED_EXPANDED) {
+      len = format_ipv6_expanded(RAW(storage) + 16 * i, str);
+    } else {
+      len = format_ipv6_compressed(RAW(storage) + 16 * i, str);
+    }
+  }
+  return Rf_mkCharLenCE(str, len, CE_NATIVE);
+}
+
+/**
+ * Turn the whole vector into strings (once), keeping them in data2.
+ */
+static SEXP packed_materialise(SEXP x){
+  SEXP strings = R_altrep_data2(x);
+  if (strings != R_NilValue) {
+    return strings;
+  }
+  SEXP data1 = R_altrep_data1(x);
+  R_xlen_t n = packed_length(x);
+  strings = PROTECT(Rf_allocVector(STRSXP, n));
+  for (R_xlen_t i = 0; i < n; i++) {
+    SET_STRING_ELT(strings, i, packed_format(data1, i));
+  }
+  R_set_altrep_data2(x, strings);
+  UNPROTECT(1);
+  return strings;
+}
+
+static SEXP packed_elt(SEXP x, R_xlen_t i){
+  SEXP strings = R_altrep_data2(x);
+  if (strings != R_NilValue) {
+    return STRING_ELT(strings, i);
+  }
+  return packed_format(R_altrep_data1(x), i);
+}
+
+static void packed_set_elt(SEXP x, R_xlen_t i, SEXP value){
+  SET_STRING_ELT(packed_materialise(x), i, value);
+}
+
+static void* packed_dataptr(SEXP x, Rboolean){
+  return DATAPTR(packed_materialise(x));
+}
+
+static const void* packed_dataptr_or_null(SEXP x){
+  SEXP strings = R_altrep_data2(x);
+  return strings == R_NilValue ? NULL : DATAPTR(strings);
+}
+
+static int packed_no_na(SEXP x){
+  SEXP families = VECTOR_ELT(R_altrep_data1(x), PACKED_FAMILIES);
+  if (families == R_NilValue) {
+    return 1;
+  }
+  R_xlen_t n = XLENGTH(families);
+  const uint8_t *f = RAW(families);
+  for (R_xlen_t i = 0; i < n; i++) {
+    if (f[i] == PACKED_NA) return 0;
+  }
+  return 1;
+}
+
+static SEXP packed_duplicate(SEXP x, Rboolean){
+  // the packed data is never modified, so an unmaterialised copy can share it
+  if (R_altrep_data2(x) != R_NilValue) {
+    return NULL;
+  }
+  return R_new_altrep(packed_ip_class, R_altrep_data1(x), R_NilValue);
+}
+
+static SEXP packed_serialized_state(SEXP x){
+  // once materialised, the strings may have been assigned to, so R
+  // serialises them instead of the (possibly stale) packed data
+  if (R_altrep_data2(x) != R_NilValue) {
+    return NULL;
+  }
+  return R_altrep_data1(x);
+}
+
+static SEXP packed_unserialize(SEXP, SEXP state){
+  return R_new_altrep(packed_ip_class, state, R_NilValue);
+}
+
+static R_xlen_t sequence_length(SEXP x){
+  return (R_xlen_t) REAL(VECTOR_ELT(R_altrep_data1(x), SEQUENCE_LENGTH))[0];
+}
+
+/**
+ * Format element i of an address sequence as a CHARSXP.
+ */
+static SEXP sequence_format(SEXP data1, R_xlen_t i){
+  uint128 ip = uint128::from_bytes(RAW(VECTOR_ELT(data1, SEQUENCE_START))) + i;
+  char str[46];
+  size_t len;
+  if (INTEGER(VECTOR_ELT(data1, SEQUENCE_FAMILY))[0] == PACKED_V4) {
+    len = format_ipv4((uint32_t) ip.lo, str);
+  } else {
+    uint8_t bytes[16];
+    ip.to_bytes(bytes);
+    len = format_ipv6_compressed(bytes, str);
+  }
+  return Rf_mkCharLenCE(str, len, CE_NATIVE);
+}
+
+static SEXP sequence_materialise(SEXP x){
+  SEXP strings = R_altrep_data2(x);
+  if (strings != R_NilValue) {
+    return strings;
+  }
+  SEXP data1 = R_altrep_data1(x);
+  R_xlen_t n = sequence_length(x);
+  strings = PROTECT(Rf_allocVector(STRSXP, n));
+  for (R_xlen_t i = 0; i < n; i++) {
+    SET_STRING_ELT(strings, i, sequence_format(data1, i));
+  }
+  R_set_altrep_data2(x, strings);
+  UNPROTECT(1);
+  return strings;
+}
+
+static SEXP sequence_elt(SEXP x, R_xlen_t i){
+  SEXP strings = R_altrep_data2(x);
+  if (strings != R_NilValue) {
+    return STRING_ELT(strings, i);
+  }
+  return sequence_format(R_altrep_data1(x), i);
+}
+
+static void sequence_set_elt(SEXP x, R_xlen_t i, SEXP value){
+  SET_STRING_ELT(sequence_materialise(x), i, value);
+}
+
+static void* sequence_dataptr(SEXP x, Rboolean){
+  return DATAPTR(sequence_materialise(x));
+}
+
+static int sequence_no_na(SEXP){
+  return 1;
+}
+
+static SEXP sequence_duplicate(SEXP x, Rboolean){
+  if (R_altrep_data2(x) != R_NilValue) {
+    return NULL;
+  }
+  return R_new_altrep(ip_sequence_class, R_altrep_data1(x), R_NilValue);
+}
+
+static SEXP sequence_unserialize(SEXP, SEXP state){
+  return R_new_altrep(ip_sequence_class, state, R_NilValue);
+}
+
+static Rboolean sequence_inspect(SEXP x, int, int, int, void (*)(SEXP, int, int, int)){
+  Rprintf("iptools address sequence (IPv%d, %s)\n",
+          INTEGER(VECTOR_ELT(R_altrep_data1(x), SEQUENCE_FAMILY))[0],
+          R_altrep_data2(x) == R_NilValue ? "lazy" : "materialised");
+  return TRUE;
+}
+
+bool is_ip_sequence(SEXP x){
+  return ALTREP(x) && R_altrep_inherits(x, ip_sequence_class) && R_altrep_data2(x) == R_NilValue;
+}
+
+SEXP ip_sequence(const uint128& start, int family, R_xlen_t length){
+  RawVector bytes(16);
+  start.to_bytes(RAW(bytes));
+  List data1 = List::create(bytes, IntegerVector::create(family), NumericVector::create((double) length));
+  return R_new_altrep(ip_sequence_class, data1, R_NilValue);
+}
+
+static Rboolean packed_inspect(SEXP x, int, int, int, void (*)(SEXP, int, int, int)){
+  Rprintf("iptools packed address vector (%s, %s)\n",
+          TYPEOF(VECTOR_ELT(R_altrep_data1(x), PACKED_STORAGE)) == INTSXP ? "IPv4" : "IPv4/IPv6",
+          R_altrep_data2(x) == R_NilValue ? "packed" : "materialised");
+  return TRUE;
+}
+
+// [[Rcpp::init]]
+void packed_ip_init(DllInfo* dll){
+  packed_ip_class = R_make_altstring_class("iptools_packed_ip", "iptools", dll);
+  R_set_altrep_Length_method(packed_ip_class, packed_length);
+  R_set_altrep_Inspect_method(packed_ip_class, packed_inspect);
+  R_set_altrep_Duplicate_method(packed_ip_class, packed_duplicate);
+  R_set_altrep_Serialized_state_method(packed_ip_class, packed_serialized_state);
+  R_set_altrep_Unserialize_method(packed_ip_class, packed_unserialize);
+  R_set_altvec_Dataptr_method(packed_ip_class, packed_dataptr);
+  R_set_altvec_Dataptr_or_null_method(packed_ip_class, packed_dataptr_or_null);
+  R_set_altstring_Elt_method(packed_ip_class, packed_elt);
+  R_set_altstring_Set_elt_method(packed_ip_class, packed_set_elt);
+  R_set_altstring_No_NA_method(packed_ip_class, packed_no_na);
+
+  ip_sequence_class = R_make_altstring_class("iptools_ip_sequence", "iptools", dll);
+  R_set_altrep_Length_method(ip_sequence_class, sequence_length);
+  R_set_altrep_Inspect_method(ip_sequence_class, sequence_inspect);
+  R_set_altrep_Duplicate_method(ip_sequence_class, sequence_duplicate);
+  R_set_altrep_Serialized_state_method(ip_sequence_class, packed_serialized_state);
+  R_set_altrep_Unserialize_method(ip_sequence_class, sequence_unserialize);
+  R_set_altvec_Dataptr_method(ip_sequence_class, sequence_dataptr);
+  R_set_altvec_Dataptr_or_null_method(ip_sequence_class, packed_dataptr_or_null);
+  R_set_altstring_Elt_method(ip_sequence_class, sequence_elt);
+  R_set_altstring_Set_elt_method(ip_sequence_class, sequence_set_elt);
+  R_set_altstring_No_NA_method(ip_sequence_class, sequence_no_na);
+}
+
+packed_ip_builder::packed_ip_builder(R_xlen_t size, bool v6, int style, const char* invalid_str) :
+  size(size), style(style), v4s(NULL), v6s(NULL), flags(NULL) {
+  if (v6) {
+    storage = Rf_allocVector(RAWSXP, size * 16);
+    v6s = RAW(storage);
+    memset(v6s, 0, size * 16);
+  } else {
+    storage = Rf_allocVector(INTSXP, size);
+    v4s = (uint32_t*) INTEGER(storage);
+  }
+  invalid = Rf_mkString(invalid_str);
+}
+
+void packed_ip_builder::set_family(R_xlen_t i, uint8_t family){
+  if (flags == NULL) {
+    uint8_t fill = v4s ? PACKED_V4 : PACKED_V6;
+    if (family == fill) {
+      return;
+    }
+    families = Rf_allocVector(RAWSXP, size);
+    flags = RAW(families);
+    memset(flags, fill, size);
+  }
+  flags[i] = family;
+}
+
+void packed_ip_builder::set_v4(R_xlen_t i, uint32_t ip){
+  if (v4s) {
+    v4s[i] = ip;
+  } else {
+    uint8_t *b = v6s + 16 * i;
+    memset(b, 0, 16);
+    b[0] = ip >> 24;
+    b[1] = ip >> 16;
+    b[2] = ip >> 8;
+    b[3] = ip;
+  }
+  set_family(i, PACKED_V4);
+}
+
+void packed_ip_builder::set_v6(R_xlen_t i, const uint8_t* ip){
+  if (v4s) {
+    throw std::range_error("cannot store an IPv6 address in an IPv4-only vector");
+  }
+  memcpy(v6s + 16 * i, ip, 16);
+  set_family(i, PACKED_V6);
+}
+
+void packed_ip_builder::set_na(R_xlen_t i){
+  if (v4s) v4s[i] = 0;
+  set_family(i, PACKED_NA);
+}
+
+void packed_ip_builder::set_invalid(R_xlen_t i){
+  if (v4s) v4s[i] = 0;
+  set_family(i, PACKED_INVALID);
+}
+
+SEXP packed_ip_builder::finish(){
+  List data1 = List::create(storage, families, IntegerVector::create(style), invalid);
+  return R_new_altrep(packed_ip_class, data1, R_NilValue);
+}
+
+SEXP packed_ip_subset(SEXP x, const std::vector < R_xlen_t >& index){
+  address_reader reader(x);
+  R_xlen_t size = (R_xlen_t) index.size();
+  bool v6 = false;
+  int style = PACKED_COMPRESSED;
+  const char* invalid_str = "";
+  if (is_ip_sequence(x)) {
+    v6 = INTEGER(VECTOR_ELT(R_altrep_data1(x), SEQUENCE_FAMILY))[0] == 6;
+  } else {
+    SEXP data1 = R_altrep_data1(x);
+    v6 = TYPEOF(VECTOR_ELT(data1, PACKED_STORAGE)) == RAWSXP;
+    style = INTEGER(VECTOR_ELT(data1, PACKED_STYLE))[0];
+    invalid_str = CHAR(STRING_ELT(VECTOR_ELT(data1, PACKED_INVALID_STR), 0));
+  }
+
+  packed_ip_builder out(size, v6, style, invalid_str);
+  uint32_t v4;
+  uint8_t bytes[16];
+  for (R_xlen_t i = 0; i < size; i++) {
+    switch (reader.family(index[i], &v4, bytes)) {
+    case PACKED_V4:
+      out.set_v4(i, v4);
+      break;
+    case PACKED_V6:
+      out.set_v6(i, bytes);
+      break;
+    case PACKED_INVALID:
+      out.set_invalid(i);
+      break;
+    default:
+      out.set_na(i);
+    }
+  }
+  return out.finish();
+}
+
+address_reader::address_reader(SEXP x) : n(Rf_xlength(x)), packed(is_packed_ip(x)),
+  sequence(is_ip_sequence(x)), seq_family(0), v4s(NULL), v6s(NULL), flags(NULL), na_ptr(CHAR(NA_STRING)) {
+  if (sequence) {
+    SEXP data1 = R_altrep_data1(x);
+    seq_start = uint128::from_bytes(RAW(VECTOR_ELT(data1, SEQUENCE_START)));
+    seq_family = INTEGER(VECTOR_ELT(data1, SEQUENCE_FAMILY))[0];
+    return;
+  }
+  if (packed) {
+    SEXP data1 = R_altrep_data1(x);
+    SEXP storage = VECTOR_ELT(data1, PACKED_STORAGE);
+    SEXP families = VECTOR_ELT(data1, PACKED_FAMILIES);
+    if (TYPEOF(storage) == INTSXP) {
+      v4s = (const uint32_t*) INTEGER(storage);
+    } else {
+      v6s = RAW(storage);
+    }
+    if (families != R_NilValue) {
+      flags = RAW(families);
+    }
+    return;
+  }
+  if (TYPEOF(x) != STRSXP) {
+    throw std::range_error("Expecting a character vector of IP addresses");
+  }
+  ptr.resize(n);
+  len.resize(n);
+  for (R_xlen_t i = 0; i < n; i++) {
+    SEXP str = STRING_ELT(x, i);
+    ptr[i] = CHAR(str);
+    len[i] = LENGTH(str);
+  }
+}
+
+//' @title Pack IP addresses into a compact vector
+//' @description \code{ip_pack} stores a vector of IPv4 and IPv6 addresses in 4 (for
+//' all-IPv4 input) or 16 bytes per address, rather than as strings. The result
+//' still behaves like a character vector, but each address is only turned back
+//' into a string when R reads it, and the functions in iptools read the packed
+//' addresses directly. \code{\link{numeric_to_ip}} and \code{\link{expand_ipv6}}
+//' return packed vectors too.
+//'
+//' @param ip_addresses a character vector of IP addresses.
+//'
+//' @return a character vector, with IPv6 addresses in their canonical compressed
+//' form ("2001:db8::1") and invalid addresses as \code{NA}.
+//'
+//' @examples
+//' x <- ip_pack(c("192.168.0.1", "2001:0db8::0001", "not an IP"))
+//' x
+//' ip_classify(x)
+//' @export
+// [[Rcpp::export]]
+SEXP ip_pack(SEXP ip_addresses){
+  if (is_packed_ip(ip_addresses)) {
+    return ip_addresses;
+  }
+  address_reader reader(ip_addresses);
+  R_xlen_t input_size = reader.size();
+  uint32_t v4;
+  uint8_t v6[16];
+  bool any_v6 = false;
+
+  for (R_xlen_t i = 0; i < input_size && !any_v6; i++) {
+    any_v6 = reader.v6(i, v6);
+  }
+
+  packed_ip_builder out(input_size, any_v6, PACKED_COMPRESSED, "");
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+    switch (reader.family(i, &v4, v6)) {
+    case PACKED_V4:
+      out.set_v4(i, v4);
+      break;
+    case PACKED_V6:
+      out.set_v6(i, v6);
+      break;
+    default:
+      out.set_na(i);
+    }
+  }
+  return out.finish();
+}
+
+//[[Rcpp::export]]
+SEXP int_range_generate(CharacterVector range){
+  if (range.size() != 1) {
+    throw std::range_error("range_generate takes a single range");
+  }
+  SEXP str = STRING_ELT(range, 0);
+  uint128 first;
+  int prefix;
+  int family = str == NA_STRING ? 0 : cidr_parse(CHAR(str), LENGTH(str), &first, &prefix);
+  if (!family || prefix < 0) {
+    throw std::range_error("Invalid range");
+  }
+
+  // as with range_boundaries, the range runs from the address as written
+  uint128 last = first | cidr_host_mask(family, prefix);
+  uint128 span = last - first;
+  if (span.hi != 0 || span.lo >= (uint64_t) R_XLEN_T_MAX) {
+    throw std::range_error("Range is too large to generate");
+  }
+  return ip_sequence(first, family, (R_xlen_t) span.lo + 1);
+}
+
+//[[Rcpp::export]]
+SEXP int_ip_sequence_slice(SEXP x, double from, double n){
+  if (!ALTREP(x) || !R_altrep_inherits(x, ip_sequence_class)) {
+    throw std::range_error("Expecting an address sequence from range_generate");
+  }
+  R_xlen_t length = sequence_length(x);
+  R_xlen_t offset = (R_xlen_t) std::min(std::max(from, 0.0), (double) length);
+  R_xlen_t size = (R_xlen_t) std::min(std::max(n, 0.0), (double) (length - offset));
+  // a materialised sequence may have been assigned to, so slice its strings
+  if (!is_ip_sequence(x)) {
+    CharacterVector out(size);
+    for (R_xlen_t i = 0; i < size; i++) {
+      SET_STRING_ELT(out, i, STRING_ELT(x, offset + i));
+    }
+    return out;
+  }
+  SEXP data1 = R_altrep_data1(x);
+  uint128 start = uint128::from_bytes(RAW(VECTOR_ELT(data1, SEQUENCE_START))) + offset;
+  return ip_sequence(start, INTEGER(VECTOR_ELT(data1, SEQUENCE_FAMILY))[0], size);
+}
@@ -0,0 +1,240 @@
+#ifndef __PACKED_IP__
+#define __PACKED_IP__
+
+#include <Rcpp.h>
+#include <vector>
+
+#include "cidr.h"
+#include "ip_parse.h"
+
+/**
+ * What each element of a packed address vector holds.
+ */
+enum packed_family {PACKED_NA = 0, PACKED_INVALID = 1, PACKED_V4 = 4, PACKED_V6 = 6};
+
+/**
+ * How the IPv6 elements of a packed address vector are written out when
+ * R reads them: "2001:db8::1" or "2001:0db8:0000:0000:0000:0000:0000:0001".
+ */
+enum packed_style {PACKED_COMPRESSED = 0, PACKED_EXPANDED = 1};
+
+/**
+ * Packed address vectors are ALTREP character vectors that store each
+ * address as 4 (IPv4-only vectors) or 16 bytes rather than as a string,
+ * and only format an element when R asks for it.
+ *
+ * data1 is a list of
+ *   - the addresses: an integer vector (one uint32 per IPv4 address) or a
+ *     raw vector (16 bytes per address; IPv4 addresses in the first 4,
+ *     network byte order),
+ *   - a raw vector of packed_family codes, or NULL if every element is a
+ *     valid address of the storage's family,
+ *   - the packed_style,
+ *   - the string PACKED_INVALID elements read as.
+ * data2 is NULL until something needs the whole vector as strings, at which
+ * point it holds them. From then on the strings are the vector (an element
+ * may have been assigned to, leaving data1 stale), and it is read and
+ * serialised as an ordinary character vector.
+ *
+ * @return true if x is a packed address vector that hasn't been materialised.
+ */
+bool is_packed_ip(SEXP x);
+
+/**
+ * Address sequences are ALTREP character vectors holding every address
+ * from a start address onwards, one per element, as the start address and
+ * a length; element i is formatted from start + i when R reads it.
+ *
+ * data1 is a list of
+ *   - the start address: a raw vector of 16 bytes, as a uint128 would
+ *     write them (IPv4 addresses in the last 4),
+ *   - the address family (4 or 6),
+ *   - the length, as a double.
+ * data2 is as for packed address vectors: once set, the strings are the
+ * vector and it is read and serialised as an ordinary character vector.
+ *
+ * @return true if x is an address sequence that hasn't been materialised.
+ */
+bool is_ip_sequence(SEXP x);
+
+/**
+ * Create an address sequence.
+ *
+ * @param start the first address.
+ *
+ * @param family the address family (4 or 6).
+ *
+ * @param length the number of addresses; start + length - 1 must not
+ * overflow the family.
+ */
+SEXP ip_sequence(const uint128& start, int family, R_xlen_t length);
+
+/**
+ * Gather the elements of a packed address vector or address sequence into
+ * a new packed vector, without formatting them. x must pass is_packed_ip()
+ * or is_ip_sequence().
+ *
+ * @param index the (0-based) positions of the elements to take, in order.
+ */
+SEXP packed_ip_subset(SEXP x, const std::vector < R_xlen_t >& index);
+
+/**
+ * Builds a packed address vector element by element.
+ */
+class packed_ip_builder {
+
+public:
+
+  /**
+   * @param size the number of elements.
+   *
+   * @param v6 whether any element may be IPv6; if not, IPv4 addresses are
+   * stored in 4 bytes rather than 16.
+   *
+   * @param style how IPv6 elements are formatted.
+   *
+   * @param invalid what PACKED_INVALID elements read as.
+   */
+  packed_ip_builder(R_xlen_t size, bool v6, int style, const char* invalid);
+
+  void set_v4(R_xlen_t i, uint32_t ip);
+  void set_v6(R_xlen_t i, const uint8_t* ip);
+  void set_na(R_xlen_t i);
+  void set_invalid(R_xlen_t i);
+
+  /**
+   * @return the finished vector.
+   */
+  SEXP finish();
+
+private:
+  R_xlen_t size;
+  int style;
+  Rcpp::RObject storage;
+  Rcpp::RObject families;
+  Rcpp::RObject invalid;
+  uint32_t *v4s;
+  uint8_t *v6s;
+  uint8_t *flags;
+
+  void set_family(R_xlen_t i, uint8_t family);
+};
+
+/**
+ * Read-only, thread-safe access to a vector of addresses held either as
+ * strings or packed, gathered on the main thread so that worker threads
+ * can use it without calling the R API. Packed vectors are read directly,
+ * without being turned into strings, and address sequences are read as
+ * their start address plus the index.
+ */
+class address_reader {
+
+public:
+
+  explicit address_reader(SEXP x);
+
+  R_xlen_t size() const {
+    return n;
+  }
+
+  /**
+   * Classify (and decode) element i.
+   *
+   * @param v4 where an IPv4 address is written.
+   *
+   * @param v6 where an IPv6 address is written.
+   *
+   * @return the element's packed_family.
+   */
+  inline int family(R_xlen_t i, uint32_t* v4, uint8_t* v6) const {
+    if (sequence) {
+      if (seq_family == PACKED_V4) {
+        *v4 = (uint32_t) (seq_start.lo + i);
+      } else {
+        (seq_start + i).to_bytes(v6);
+      }
+      return seq_family;
+    }
+    if (packed) {
+      int fam = flags ? (int) flags[i] : (v4s ? (int) PACKED_V4 : (int) PACKED_V6);
+      if (fam == PACKED_V4) {
+        *v4 = v4s ? v4s[i] : read_v4(v6s + 16 * i);
+      } else if (fam == PACKED_V6) {
+        memcpy(v6, v6s + 16 * i, 16);
+      }
+      return fam;
+    }
+    if (ptr[i] == na_ptr) {
+      return PACKED_NA;
+    }
+    if (parse_ipv4(ptr[i], len[i], v4) == IP_PARSE_OK) {
+      return PACKED_V4;
+    }
+    if (parse_ipv6(ptr[i], len[i], v6) == IP_PARSE_OK) {
+      return PACKED_V6;
+    }
+    return PACKED_INVALID;
+  }
+
+  /**
+   * @return true (with the address written to out) if element i is IPv4.
+   */
+  inline bool v4(R_xlen_t i, uint32_t* out) const {
+    if (sequence) {
+      *out = (uint32_t) (seq_start.lo + i);
+      return seq_family == PACKED_V4;
+    }
+    if (packed) {
+      if (v4s) {
+        if (flags && flags[i] != PACKED_V4) return false;
+        *out = v4s[i];
+        return true;
+      }
+      if (!flags || flags[i] != PACKED_V4) return false;
+      *out = read_v4(v6s + 16 * i);
+      return true;
+    }
+    return parse_ipv4(ptr[i], len[i], out) == IP_PARSE_OK;
+  }
+
+  /**
+   * @return true (with the address written to out) if element i is IPv6.
+   */
+  inline bool v6(R_xlen_t i, uint8_t* out) const {
+    if (sequence) {
+      if (seq_family != PACKED_V6) return false;
+      (seq_start + i).to_bytes(out);
+      return true;
+    }
+    if (packed) {
+      if (v4s || (flags && flags[i] != PACKED_V6)) return false;
+      memcpy(out, v6s + 16 * i, 16);
+      return true;
+    }
+    return parse_ipv6(ptr[i], len[i], out) == IP_PARSE_OK;
+  }
+
+  inline bool is_na(R_xlen_t i) const {
+    if (sequence) return false;
+    return packed ? (flags && flags[i] == PACKED_NA) : ptr[i] == na_ptr;
+  }
+
+private:
+  R_xlen_t n;
+  bool packed;
+  bool sequence;
+  uint128 seq_start;
+  int seq_family;
+  const uint32_t* v4s;
+  const uint8_t* v6s;
+  const uint8_t* flags;
+  std::vector < const char* > ptr;
+  std::vector < int > len;
+  const char* na_ptr;
+
+  static inline uint32_t read_v4(const uint8_t* b) {
+    return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+  }
+};
+
+#endif
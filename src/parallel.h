@@ -0,0 +1,157 @@
+#ifndef __IPTOOLS_PARALLEL__
+#define __IPTOOLS_PARALLEL__
+
+#include <Rcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * The number of elements handed out at a time, and (on the serial path)
+ * the interval between interrupt checks.
+ */
+static const R_xlen_t parallel_chunk_size = 10000;
+
+/**
+ * Read the iptools.threads option.
+ *
+ * @return the number of threads to use; 1 (the default) when the option
+ * is unset or invalid, or every core the machine reports when it is 0.
+ */
+inline int iptools_threads(){
+  SEXP option = Rf_GetOption1(Rf_install("iptools.threads"));
+  if (Rf_isNull(option) || Rf_length(option) < 1) {
+    return 1;
+  }
+  int threads = Rf_asInteger(option);
+  if (threads == 0) {
+    threads = (int) std::thread::hardware_concurrency();
+  }
+  return (threads == NA_INTEGER || threads < 1) ? 1 : threads;
+}
+
+/**
+ * The strings of a character vector, gathered on the main thread so that
+ * worker threads can read them without going through the R API.
+ */
+struct string_refs {
+
+  std::vector < const char* > ptr;
+  std::vector < int > len;
+  const char* na_ptr;
+
+  explicit string_refs(const Rcpp::CharacterVector& x) : ptr(x.size()), len(x.size()) {
+    na_ptr = CHAR(NA_STRING);
+    for (R_xlen_t i = 0; i < x.size(); i++) {
+      SEXP str = STRING_ELT(x, i);
+      ptr[i] = CHAR(str);
+      len[i] = LENGTH(str);
+    }
+  }
+
+  bool is_na(R_xlen_t i) const {
+    return ptr[i] == na_ptr;
+  }
+};
+
+static void parallel_check_interrupt(void*){
+  R_CheckUserInterrupt();
+}
+
+/**
+ * Run body(begin, end) over [0, n) in chunks of parallel_chunk_size,
+ * spread across iptools_threads() threads.
+ *
+ * body is called from worker threads, so it must not touch the R API (read
+ * inputs through raw pointers or a string_refs, write to preallocated
+ * output) and every index must be written independently of the others, so
+ * that the result is the same however the chunks are scheduled. The calling
+ * thread works through chunks as well and checks for user interrupts
+ * between them; on an interrupt the workers are stopped and joined before
+ * the interrupt is passed on to R.
+ *
+ * @param n the number of elements.
+ *
+ * @param body the per-chunk work.
+ */
+template < typename Body >
+void parallel_for(R_xlen_t n, const Body& body){
+
+  int threads = iptools_threads();
+
+  if (threads <= 1 || n <= parallel_chunk_size) {
+    for (R_xlen_t begin = 0; begin < n; begin += parallel_chunk_size) {
+      Rcpp::checkUserInterrupt();
+      body(begin, std::min(n, begin + parallel_chunk_size));
+    }
+    return;
+  }
+
+  R_xlen_t chunks = (n + parallel_chunk_size - 1) / parallel_chunk_size;
+  if (threads > chunks) {
+    threads = (int) chunks;
+  }
+
+  std::atomic < R_xlen_t > next(0);
+  std::atomic < bool > stop(false);
+  std::atomic < bool > failed(false);
+
+  struct worker {
+    static void run(R_xlen_t n, const Body& body, std::atomic < R_xlen_t >& next,
+                    std::atomic < bool >& stop, std::atomic < bool >& failed){
+      try {
+        while (!stop.load(std::memory_order_relaxed)) {
+          R_xlen_t begin = next.fetch_add(parallel_chunk_size);
+          if (begin >= n) {
+            break;
+          }
+          body(begin, std::min(n, begin + parallel_chunk_size));
+        }
+      } catch (...) {
+        failed = true;
+        stop = true;
+      }
+    }
+  };
+
+  std::vector < std::thread > pool;
+  pool.reserve(threads - 1);
+  for (int t = 1; t < threads; t++) {
+    pool.push_back(std::thread(&worker::run, n, std::cref(body), std::ref(next),
+                               std::ref(stop), std::ref(failed)));
+  }
+
+  bool interrupted = false;
+  while (!stop.load(std::memory_order_relaxed)) {
+    if (R_ToplevelExec(parallel_check_interrupt, NULL) == FALSE) {
+      interrupted = true;
+      stop = true;
+      break;
+    }
+    R_xlen_t begin = next.fetch_add(parallel_chunk_size);
+    if (begin >= n) {
+      break;
+    }
+    try {
+      body(begin, std::min(n, begin + parallel_chunk_size));
+    } catch (...) {
+      failed = true;
+      stop = true;
+    }
+  }
+
+  for (size_t t = 0; t < pool.size(); t++) {
+    pool[t].join();
+  }
+
+  if (interrupted) {
+    throw Rcpp::internal::InterruptedException();
+  }
+  if (failed) {
+    throw std::runtime_error("a worker thread failed");
+  }
+}
+
+#endif
@@ -0,0 +1,224 @@
+#include <Rcpp.h>
+#include <map>
+
+#include "ip_parse.h"
+#include "packed_ip.h"
+#include "prefix_table.h"
+
+using namespace Rcpp;
+
+labelled_prefix_table* get_prefix_table(SEXP tbl){
+  if (TYPEOF(tbl) != EXTPTRSXP || !Rf_inherits(tbl, "iptools_prefix_table")) {
+    throw std::range_error("Not a compiled prefix table");
+  }
+  labelled_prefix_table* ptr = (labelled_prefix_table*) R_ExternalPtrAddr(tbl);
+  if (ptr == NULL) {
+    throw std::range_error("The prefix table is no longer valid (was it saved and reloaded? Use write_prefix_table() instead)");
+  }
+  return ptr;
+}
+
+// [[Rcpp::export]]
+SEXP prefix_table_build(SEXP networks, IntegerVector lengths, CharacterVector values) {
+
+  R_xlen_t input_size = Rf_xlength(networks);
+  if (lengths.size() != input_size || values.size() != input_size) {
+    throw std::range_error("networks, lengths and values must be the same length");
+  }
+
+  std::vector < uint32_t > nets;
+  std::vector < int > lens;
+  std::vector < int32_t > idx;
+  std::map < std::string, int32_t > seen;
+  NumericVector numeric_networks;
+  bool is_character = TYPEOF(networks) == STRSXP;
+  uint32_t network = 0;
+
+  if (!is_character) {
+    numeric_networks = networks;
+  }
+
+  XPtr < labelled_prefix_table > out(new labelled_prefix_table, true);
+
+  nets.reserve(input_size);
+  lens.reserve(input_size);
+  idx.reserve(input_size);
+
+  for (R_xlen_t i = 0; i < input_size; i++) {
+    if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+    if (lengths[i] == NA_INTEGER || lengths[i] < 0 || lengths[i] > 32) {
+      continue;
+    }
+    if (is_character) {
+      SEXP network_str = STRING_ELT(networks, i);
+      if (network_str == NA_STRING ||
+          parse_ipv4(CHAR(network_str), LENGTH(network_str), &network) != IP_PARSE_OK) {
+        continue;
+      }
+    } else {
+      if (ISNAN(numeric_networks[i]) || numeric_networks[i] < 0 || numeric_networks[i] > 4294967295.0) {
+        continue;
+      }
+      network = (uint32_t) numeric_networks[i];
+    }
+    std::string label = values[i] == NA_STRING ? std::string("NA") : std::string(values[i]);
+    std::map < std::string, int32_t >::iterator it = seen.find(label);
+    if (it == seen.end()) {
+      it = seen.insert(std::make_pair(label, (int32_t) out->labels.size())).first;
+      out->labels.push_back(label);
+    }
+    nets.push_back(network);
+    lens.push_back(lengths[i]);
+    idx.push_back(it->second);
+  }
+
+  out->table.build(nets, lens, idx);
+  out.attr("class") = "iptools_prefix_table";
+
+  return out;
+}
+
+// [[Rcpp::export]]
+CharacterVector prefix_table_lookup(SEXP tbl, SEXP ip_addresses) {
+
+  labelled_prefix_table* ptr = get_prefix_table(tbl);
+  R_xlen_t input_size = Rf_xlength(ip_addresses);
+  CharacterVector output(input_size);
+  CharacterVector labels(ptr->labels.size());
+  int32_t hit;
+  uint32_t ip;
+
+  // one CHARSXP per distinct value, shared by every matching row
+  for (unsigned int i = 0; i < ptr->labels.size(); i++) {
+    SET_STRING_ELT(labels, i, Rf_mkCharLenCE(ptr->labels[i].data(), ptr->labels[i].size(), CE_UTF8));
+  }
+
+  if (TYPEOF(ip_addresses) == STRSXP) {
+    address_reader ips(ip_addresses);
+    for (R_xlen_t i = 0; i < input_size; i++) {
+      if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+      hit = ips.v4(i, &ip) ? ptr->table.lookup(ip) : prefix_table::no_match;
+      SET_STRING_ELT(output, i, hit == prefix_table::no_match ? NA_STRING : STRING_ELT(labels, hit));
+    }
+  } else {
+    NumericVector ips(ip_addresses);
+    for (R_xlen_t i = 0; i < input_size; i++) {
+      if ((i % 10000) == 0) Rcpp::checkUserInterrupt();
+      hit = prefix_table::no_match;
+      if (!ISNAN(ips[i]) && ips[i] >= 0 && ips[i] <= 4294967295.0) {
+        hit = ptr->table.lookup((uint32_t) ips[i]);
+      }
+      SET_STRING_ELT(output, i, hit == prefix_table::no_match ? NA_STRING : STRING_ELT(labels, hit));
+    }
+  }
+
+  return output;
+}
+
+// [[Rcpp::export]]
+double prefix_table_size(SEXP tbl) {
+  return (double) get_prefix_table(tbl)->table.size();
+}
+
+// [[Rcpp::export]]
+void prefix_table_write(SEXP tbl, std::string path) {
+
+  labelled_prefix_table* ptr = get_prefix_table(tbl);
+  const prefix_table& table = ptr->table;
+
+  prefix_table_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, prefix_table_magic, sizeof(header.magic));
+  header.version = prefix_table_version;
+  header.byte_order = prefix_table_byte_order;
+  header.prefix_count = table.size();
+  header.level1_slots = table.level_slots(1);
+  header.level2_slots = table.level_slots(2);
+  header.label_count = ptr->labels.size();
+
+  std::vector < uint64_t > offsets(1, 0);
+  for (size_t i = 0; i < ptr->labels.size(); i++) {
+    offsets.push_back(offsets.back() + ptr->labels[i].size());
+  }
+  header.label_bytes = offsets.back();
+
+  FILE* out = fopen(path.c_str(), "wb");
+  if (out == NULL) {
+    throw std::range_error("Cannot open " + path + " for writing");
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+  for (int depth = 0; depth < 3 && ok; depth++) {
+    size_t slots = table.level_slots(depth);
+    ok = slots == 0 || fwrite(table.level(depth), sizeof(prefix_table::slot), slots, out) == slots;
+  }
+  ok = ok && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), out) == offsets.size();
+  for (size_t i = 0; i < ptr->labels.size() && ok; i++) {
+    const std::string& label = ptr->labels[i];
+    ok = label.empty() || fwrite(label.data(), 1, label.size(), out) == label.size();
+  }
+  ok = (fclose(out) == 0) && ok;
+  if (!ok) {
+    throw std::range_error("Error writing " + path);
+  }
+}
+
+// [[Rcpp::export]]
+SEXP prefix_table_read(std::string path) {
+
+  XPtr < labelled_prefix_table > out(new labelled_prefix_table, true);
+  if (!out->map.open(path)) {
+    throw std::range_error("Cannot open " + path);
+  }
+  const char* data = out->map.data();
+  size_t size = out->map.size();
+  const std::string invalid = path + " is not a valid prefix table file";
+
+  prefix_table_header header;
+  if (size < sizeof(header)) {
+    throw std::range_error(invalid);
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, prefix_table_magic, sizeof(header.magic)) != 0) {
+    throw std::range_error(invalid);
+  }
+  if (header.version > prefix_table_version) {
+    throw std::range_error(path + " was written by a newer version of iptools");
+  }
+  if (header.byte_order != prefix_table_byte_order) {
+    throw std::range_error(path + " was written on a machine with a different byte order");
+  }
+
+  // sizes are checked against the file before anything is read from it
+  const uint64_t limit = (uint64_t) 1 << 40;
+  if (header.level1_slots > limit || header.level2_slots > limit ||
+      header.label_count > limit || header.label_bytes > limit) {
+    throw std::range_error(invalid);
+  }
+  uint64_t slots = 65536 + header.level1_slots + header.level2_slots;
+  uint64_t offsets_at = sizeof(header) + slots * sizeof(prefix_table::slot);
+  uint64_t labels_at = offsets_at + (header.label_count + 1) * sizeof(uint64_t);
+  if (labels_at + header.label_bytes != size) {
+    throw std::range_error(invalid);
+  }
+
+  const uint64_t* offsets = (const uint64_t*) (data + offsets_at);
+  if (offsets[0] != 0 || offsets[header.label_count] != header.label_bytes) {
+    throw std::range_error(invalid);
+  }
+  out->labels.reserve(header.label_count);
+  for (uint64_t i = 0; i < header.label_count; i++) {
+    if (offsets[i + 1] < offsets[i]) {
+      throw std::range_error(invalid);
+    }
+    out->labels.push_back(std::string(data + labels_at + offsets[i], offsets[i + 1] - offsets[i]));
+  }
+
+  const prefix_table::slot* levels = (const prefix_table::slot*) (data + sizeof(header));
+  if (!out->table.attach(levels, header.level1_slots, header.level2_slots,
+                         header.prefix_count, header.label_count)) {
+    throw std::range_error(invalid);
+  }
+
+  out.attr("class") = "iptools_prefix_table";
+  return out;
+}
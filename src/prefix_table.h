@@ -0,0 +1,293 @@
+#ifndef __PREFIX_TABLE__
+#define __PREFIX_TABLE__
+
+#include <Rcpp.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+/**
+ * A compiled IPv4 longest-prefix-match table.
+ *
+ * Prefixes are expanded into a three-level multibit trie with strides of
+ * 16, 8 and 8 bits (a "DIR-16-8-8" layout). Every slot holds the index of
+ * the value of the longest prefix covering it, so a lookup is at most
+ * three array reads and never has to backtrack.
+ *
+ * Lookups read the levels through plain pointers, so a table can either
+ * own its levels (after build()) or be attached to levels stored
+ * elsewhere, such as in a memory-mapped file (see attach()).
+ */
+class prefix_table {
+
+public:
+
+  /**
+   * The value returned by lookup() for addresses no prefix covers.
+   */
+  static const int32_t no_match = -1;
+
+  /**
+   * One slot of a level: the value of the longest prefix covering it, and
+   * the index of the 256-slot node below it in the next level (or -1).
+   */
+  struct slot {
+    int32_t value;
+    int32_t child;
+    slot() : value(no_match), child(-1) {}
+  };
+
+  prefix_table() : level0(65536), prefix_count(0) {
+    point_at_own_levels();
+  }
+
+  /**
+   * Build the table from a set of prefixes, replacing any existing contents.
+   *
+   * @param networks the network addresses of the prefixes, host byte order.
+   * Host bits beyond the prefix length are ignored.
+   *
+   * @param lengths the prefix lengths (0-32). Entries outside that range
+   * are skipped.
+   *
+   * @param values the index of the value each prefix maps to. If the same
+   * prefix appears more than once the last one wins.
+   */
+  void build(const std::vector < uint32_t >& networks,
+             const std::vector < int >& lengths,
+             const std::vector < int32_t >& values){
+
+    level0.assign(65536, slot());
+    level1.clear();
+    level2.clear();
+    prefix_count = 0;
+
+    // shorter prefixes go in first, so a longer one can simply overwrite
+    // every slot it covers
+    std::vector < size_t > order;
+    order.reserve(networks.size());
+    for (size_t i = 0; i < networks.size(); i++) {
+      if (lengths[i] >= 0 && lengths[i] <= 32) {
+        order.push_back(i);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(), by_length(lengths));
+
+    for (size_t i = 0; i < order.size(); i++) {
+      insert(networks[order[i]], lengths[order[i]], values[order[i]]);
+    }
+    prefix_count = order.size();
+    point_at_own_levels();
+  }
+
+  /**
+   * Use levels stored elsewhere instead of the table's own; they must
+   * outlive the table (or the next build()). Nothing is copied.
+   *
+   * @param levels the 65536 level 0 slots, followed by level1_slots level 1
+   * slots and level2_slots level 2 slots.
+   *
+   * @param value_count the number of values slots may index.
+   *
+   * @return false (leaving the table unchanged) if any child index points
+   * outside its level or any value is out of range, so a corrupt file
+   * can't cause out-of-bounds reads.
+   */
+  bool attach(const slot* levels, size_t level1_slots, size_t level2_slots,
+              size_t prefixes, size_t value_count){
+    if ((level1_slots % 256) != 0 || (level2_slots % 256) != 0) {
+      return false;
+    }
+    size_t total = 65536 + level1_slots + level2_slots;
+    for (size_t i = 0; i < total; i++) {
+      size_t below = i < 65536 ? level1_slots : i < 65536 + level1_slots ? level2_slots : 0;
+      if (levels[i].child >= 0 && ((size_t) levels[i].child << 8) >= below) {
+        return false;
+      }
+      if (levels[i].value != no_match && (levels[i].value < 0 || (size_t) levels[i].value >= value_count)) {
+        return false;
+      }
+    }
+    level0.clear();
+    level1.clear();
+    level2.clear();
+    l0 = levels;
+    l1 = levels + 65536;
+    l2 = levels + 65536 + level1_slots;
+    l1_slots = level1_slots;
+    l2_slots = level2_slots;
+    prefix_count = prefixes;
+    return true;
+  }
+
+  /**
+   * Find the value of the longest prefix covering an address.
+   *
+   * @param ip an IPv4 address, host byte order.
+   *
+   * @return the value index, or no_match.
+   */
+  inline int32_t lookup(uint32_t ip) const {
+    const slot& s0 = l0[ip >> 16];
+    if (s0.child < 0) return s0.value;
+    const slot& s1 = l1[((size_t)s0.child << 8) | ((ip >> 8) & 0xff)];
+    if (s1.child < 0) return s1.value;
+    return l2[((size_t)s1.child << 8) | (ip & 0xff)].value;
+  }
+
+  /**
+   * @return the number of prefixes the table was built from.
+   */
+  size_t size() const {
+    return prefix_count;
+  }
+
+  /**
+   * The levels, and the number of slots in each, for writing the table out.
+   */
+  const slot* level(int depth) const {
+    return depth == 0 ? l0 : depth == 1 ? l1 : l2;
+  }
+
+  size_t level_slots(int depth) const {
+    return depth == 0 ? 65536 : depth == 1 ? l1_slots : l2_slots;
+  }
+
+private:
+
+  struct by_length {
+    const std::vector < int >& lengths;
+    by_length(const std::vector < int >& l) : lengths(l) {}
+    bool operator()(size_t a, size_t b) const { return lengths[a] < lengths[b]; }
+  };
+
+  std::vector < slot > level0;
+  std::vector < slot > level1;
+  std::vector < slot > level2;
+  const slot* l0;
+  const slot* l1;
+  const slot* l2;
+  size_t l1_slots;
+  size_t l2_slots;
+  size_t prefix_count;
+
+  // the level pointers would dangle in a copy
+  prefix_table(const prefix_table&);
+  prefix_table& operator=(const prefix_table&);
+
+  void point_at_own_levels(){
+    l0 = level0.data();
+    l1 = level1.data();
+    l2 = level2.data();
+    l1_slots = level1.size();
+    l2_slots = level2.size();
+  }
+
+  /**
+   * Allocate a 256-slot node in a lower level, seeded with the value of
+   * the slot above it, and return its index.
+   */
+  static int32_t add_node(std::vector < slot >& level, int32_t value){
+    int32_t node = (int32_t)(level.size() >> 8);
+    slot s;
+    s.value = value;
+    level.resize(level.size() + 256, s);
+    return node;
+  }
+
+  void fill(std::vector < slot >& level, size_t from, size_t count, int32_t value, int depth){
+    for (size_t i = from; i < from + count; i++) {
+      level[i].value = value;
+      if (level[i].child >= 0) {
+        // a longer prefix inserted earlier can't exist, so the whole
+        // subtree now belongs to this prefix
+        if (depth == 0) {
+          fill(level1, (size_t)level[i].child << 8, 256, value, 1);
+        } else {
+          fill(level2, (size_t)level[i].child << 8, 256, value, 2);
+        }
+      }
+    }
+  }
+
+  void insert(uint32_t network, int length, int32_t value){
+
+    network = length == 0 ? 0 : network & (0xffffffffU << (32 - length));
+
+    if (length <= 16) {
+      fill(level0, network >> 16, (size_t)1 << (16 - length), value, 0);
+      return;
+    }
+
+    slot& s0 = level0[network >> 16];
+    if (s0.child < 0) {
+      int32_t node = add_node(level1, s0.value);
+      level0[network >> 16].child = node;
+    }
+    size_t base1 = (size_t)level0[network >> 16].child << 8;
+
+    if (length <= 24) {
+      fill(level1, base1 | ((network >> 8) & 0xff), (size_t)1 << (24 - length), value, 1);
+      return;
+    }
+
+    size_t i1 = base1 | ((network >> 8) & 0xff);
+    if (level1[i1].child < 0) {
+      int32_t node = add_node(level2, level1[i1].value);
+      level1[i1].child = node;
+    }
+    size_t base2 = (size_t)level1[i1].child << 8;
+
+    fill(level2, base2 | (network & 0xff), (size_t)1 << (32 - length), value, 2);
+  }
+
+};
+
+/**
+ * A prefix_table plus the distinct values its slots index into;
+ * this is what lives behind the external pointer handed to R. Tables read
+ * from disk keep the file mapped, and their levels point into it.
+ */
+struct labelled_prefix_table {
+  prefix_table table;
+  std::vector < std::string > labels;
+  mapped_file map;
+};
+
+/**
+ * The start of a prefix table file. It is followed by
+ *   - the 65536 + level1_slots + level2_slots slots of the three levels,
+ *     as prefix_table::slot (two int32s),
+ *   - label_count + 1 uint64 offsets into the label text (the last one
+ *     being label_bytes),
+ *   - label_bytes of label text.
+ * Everything is in the byte order of the machine that wrote it, which the
+ * byte_order field records, and every section starts 8-byte aligned, so
+ * the levels can be used straight from a mapping of the file.
+ */
+struct prefix_table_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t prefix_count;
+  uint64_t level1_slots;
+  uint64_t level2_slots;
+  uint64_t label_count;
+  uint64_t label_bytes;
+  uint64_t reserved;
+};
+
+static const char prefix_table_magic[8] = {'I', 'P', 'T', 'P', 'F', 'X', 'T', 0};
+static const uint32_t prefix_table_version = 1;
+static const uint32_t prefix_table_byte_order = 0x01020304;
+
+/**
+ * @return the table behind an iptools_prefix_table external pointer, or
+ * throw if tbl isn't one.
+ */
+labelled_prefix_table* get_prefix_table(SEXP tbl);
+
+#endif
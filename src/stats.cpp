@@ -0,0 +1,116 @@
+#include <Rcpp.h>
+
+#include "stats.h"
+
+using namespace Rcpp;
+
+stats_counters stats_table[STATS_FUNCTION_COUNT];
+
+const char* stats_names[STATS_FUNCTION_COUNT] = {
+  "ip_to_numeric",
+  "numeric_to_ip",
+  "ip_classify",
+  "is_multicast",
+  "expand_ipv6",
+  "v6_scope",
+  "ip_to_subnet",
+  "subnet_counts",
+  "ip_order",
+  "ip_sort",
+  "ip_count",
+  "ip_distinct",
+  "ip_to_iana",
+  "ipv6_to_bytes",
+  "ip_to_binary_string",
+  "ip_numeric_to_binary_string",
+  "ip_in_range",
+  "ip_in_any",
+  "range_index",
+  "range_boundaries",
+  "validate_range",
+  "range_boundaries_to_cidr",
+  "cidr_decompose",
+  "cidr_collapse",
+  "cidr_union",
+  "cidr_intersect",
+  "cidr_setdiff",
+  "xff_extract",
+  "hostname_to_ip",
+  "ip_to_hostname",
+  "hostname_to_ip_async",
+  "ip_to_hostname_async"
+};
+
+//' @title Inspect and reset iptools' performance counters
+//' @description \code{iptools_stats} reports how much work each of iptools'
+//' vectorised functions has done since the package was loaded (or since
+//' \code{iptools_stats_reset} was last called): how often it was called, how many
+//' elements it processed and how many of them were invalid, how many exceptions
+//' it caught internally, and how long it took. Record it in a job's log to see
+//' throughput and invalid-input rates per function.
+//'
+//' @return for \code{iptools_stats}, a data.frame with one row per function and
+//' the columns "function", "calls", "elements", "invalid" (elements that weren't
+//' valid input, such as unparseable addresses or ranges), "exceptions",
+//' "seconds" (total wall-clock time), "elements_per_sec" and "invalid_rate"
+//' (\code{NA} for functions not yet called). \code{iptools_stats_reset} returns
+//' nothing.
+//'
+//' @details The counters are updated with relaxed atomic operations once per call
+//' (or per chunk, on the multithreaded paths), so they cost next to nothing. The
+//' "range_index" row is a stage rather than a function: building the merged range
+//' index inside \code{\link{ip_in_any}} and \code{\link{xff_extract}}, whose own
+//' rows include that time. Functions implemented in terms of others, such as
+//' \code{is_ipv4}, are counted under the function they call.
+//'
+//' If iptools was built with \code{-DIPTOOLS_NO_STATS} the counting is compiled
+//' out and every count is zero.
+//' @export
+//' @examples
+//' iptools_stats_reset()
+//' invisible(ip_to_numeric(c("192.168.0.1", "not an ip")))
+//' stats <- iptools_stats()
+//' stats[stats$calls > 0, ]
+// [[Rcpp::export]]
+DataFrame iptools_stats() {
+
+  CharacterVector name(STATS_FUNCTION_COUNT);
+  NumericVector calls(STATS_FUNCTION_COUNT), elements(STATS_FUNCTION_COUNT),
+    invalid(STATS_FUNCTION_COUNT), exceptions(STATS_FUNCTION_COUNT),
+    seconds(STATS_FUNCTION_COUNT), rate(STATS_FUNCTION_COUNT), invalid_rate(STATS_FUNCTION_COUNT);
+
+  for (int i = 0; i < STATS_FUNCTION_COUNT; i++) {
+    const stats_counters& counters = stats_table[i];
+    name[i] = stats_names[i];
+    calls[i] = (double) counters.calls.load(std::memory_order_relaxed);
+    elements[i] = (double) counters.elements.load(std::memory_order_relaxed);
+    invalid[i] = (double) counters.invalid.load(std::memory_order_relaxed);
+    exceptions[i] = (double) counters.exceptions.load(std::memory_order_relaxed);
+    seconds[i] = counters.nanoseconds.load(std::memory_order_relaxed) / 1e9;
+    rate[i] = seconds[i] > 0 ? elements[i] / seconds[i] : NA_REAL;
+    invalid_rate[i] = elements[i] > 0 ? invalid[i] / elements[i] : NA_REAL;
+  }
+
+  return DataFrame::create(_["function"] = name,
+                           _["calls"] = calls,
+                           _["elements"] = elements,
+                           _["invalid"] = invalid,
+                           _["exceptions"] = exceptions,
+                           _["seconds"] = seconds,
+                           _["elements_per_sec"] = rate,
+                           _["invalid_rate"] = invalid_rate,
+                           _["stringsAsFactors"] = false);
+}
+
+//' @rdname iptools_stats
+//' @export
+// [[Rcpp::export]]
+void iptools_stats_reset() {
+  for (int i = 0; i < STATS_FUNCTION_COUNT; i++) {
+    stats_table[i].calls.store(0, std::memory_order_relaxed);
+    stats_table[i].elements.store(0, std::memory_order_relaxed);
+    stats_table[i].invalid.store(0, std::memory_order_relaxed);
+    stats_table[i].exceptions.store(0, std::memory_order_relaxed);
+    stats_table[i].nanoseconds.store(0, std::memory_order_relaxed);
+  }
+}
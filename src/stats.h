@@ -0,0 +1,125 @@
+#ifndef __IPTOOLS_STATS__
+#define __IPTOOLS_STATS__
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+
+/**
+ * The functions (and stages) whose work iptools_stats() reports. stats_names,
+ * in stats.cpp, holds their names in the same order.
+ */
+enum stats_function {
+  STATS_IP_TO_NUMERIC,
+  STATS_NUMERIC_TO_IP,
+  STATS_IP_CLASSIFY,
+  STATS_IS_MULTICAST,
+  STATS_EXPAND_IPV6,
+  STATS_V6_SCOPE,
+  STATS_IP_TO_SUBNET,
+  STATS_SUBNET_COUNTS,
+  STATS_IP_ORDER,
+  STATS_IP_SORT,
+  STATS_IP_COUNT,
+  STATS_IP_DISTINCT,
+  STATS_IP_TO_IANA,
+  STATS_IPV6_TO_BYTES,
+  STATS_IP_TO_BINARY_STRING,
+  STATS_IP_NUMERIC_TO_BINARY_STRING,
+  STATS_IP_IN_RANGE,
+  STATS_IP_IN_ANY,
+  STATS_RANGE_INDEX,
+  STATS_RANGE_BOUNDARIES,
+  STATS_VALIDATE_RANGE,
+  STATS_RANGE_BOUNDARIES_TO_CIDR,
+  STATS_CIDR_DECOMPOSE,
+  STATS_CIDR_COLLAPSE,
+  STATS_CIDR_UNION,
+  STATS_CIDR_INTERSECT,
+  STATS_CIDR_SETDIFF,
+  STATS_XFF_EXTRACT,
+  STATS_HOSTNAME_TO_IP,
+  STATS_IP_TO_HOSTNAME,
+  STATS_HOSTNAME_TO_IP_ASYNC,
+  STATS_IP_TO_HOSTNAME_ASYNC,
+  STATS_FUNCTION_COUNT
+};
+
+/**
+ * The running totals for one function. They are only ever updated with
+ * relaxed atomic adds, so worker threads can update them too; they are
+ * statistics, not synchronisation.
+ */
+struct stats_counters {
+  std::atomic < uint64_t > calls;
+  std::atomic < uint64_t > elements;
+  std::atomic < uint64_t > invalid;
+  std::atomic < uint64_t > exceptions;
+  std::atomic < uint64_t > nanoseconds;
+};
+
+extern stats_counters stats_table[STATS_FUNCTION_COUNT];
+extern const char* stats_names[STATS_FUNCTION_COUNT];
+
+/**
+ * Count an exception thrown and caught inside fn.
+ */
+#ifndef IPTOOLS_NO_STATS
+inline void stats_exception(stats_function fn){
+  stats_table[fn].exceptions.fetch_add(1, std::memory_order_relaxed);
+}
+#else
+inline void stats_exception(stats_function){}
+#endif
+
+/**
+ * Counts one call to a function, and its elements, and times it from
+ * construction to destruction. Hot loops should total their invalid
+ * elements locally (per chunk, on the parallel paths) and report them with
+ * one invalid() call, rather than touching the counters per element.
+ *
+ * Building with -DIPTOOLS_NO_STATS turns all of this into no-ops.
+ */
+class stats_call {
+
+public:
+
+#ifndef IPTOOLS_NO_STATS
+
+  stats_call(stats_function fn, uint64_t elements) : counters(stats_table[fn]),
+    start(std::chrono::steady_clock::now()) {
+    counters.elements.fetch_add(elements, std::memory_order_relaxed);
+  }
+
+  ~stats_call(){
+    uint64_t elapsed = std::chrono::duration_cast < std::chrono::nanoseconds >(
+      std::chrono::steady_clock::now() - start).count();
+    counters.nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+    counters.calls.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Add count to the function's invalid inputs; safe to call from worker threads.
+   */
+  void invalid(uint64_t count) const {
+    if (count) {
+      counters.invalid.fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  stats_counters& counters;
+  std::chrono::steady_clock::time_point start;
+
+#else
+
+  stats_call(stats_function, uint64_t) {}
+  void invalid(uint64_t) const {}
+
+#endif
+
+  stats_call(const stats_call&);
+  stats_call& operator=(const stats_call&);
+};
+
+#endif